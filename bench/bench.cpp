@@ -0,0 +1,466 @@
+#include "../include/training.hpp"
+#include "../include/evaluation.hpp"
+#include "../include/idx_dataset.hpp"
+#include "../include/idx_stream.hpp"
+#include "../include/kernels.hpp"
+#include "../include/inference_engine.hpp"
+#include "../include/quantized_engine.hpp"
+#include "../include/network.hpp"
+#include "../include/sparse_images.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <sched.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+/*
+ * microbenchmarks for the training hot paths
+ * every case is warmed up, then timed call by call and reported as median / p95
+ * results are printed as a table and written as JSON for tracking across changes
+ *
+ * usage: bench [results.json] [cpu]
+ */
+
+#define BENCH_INPUTS 784
+#define BENCH_CLASSES 10
+#define BENCH_SAMPLES 1024
+#define WARMUP_ITERATIONS 200
+#define MEASURED_ITERATIONS 2000
+
+struct RESULT
+{
+    std::string name;
+    int width;
+    int batch;
+    int iterations;
+    double median_ns;
+    double p95_ns;
+    double mean_ns;
+    double min_ns;
+    double bytes; // weight bytes streamed per call, 0 when not tracked
+};
+
+static std::vector<RESULT> results;
+
+/*
+ * time fn call by call and record the statistics
+ */
+template <typename Function>
+static void measure(const std::string &name, int width, int batch, int iterations, Function fn, double bytes = 0.0)
+{
+    for (int i = 0; i < WARMUP_ITERATIONS && i < iterations; i++)
+    {
+        fn(i);
+    }
+
+    std::vector<double> samples(iterations);
+    for (int i = 0; i < iterations; i++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        fn(i);
+        samples[i] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    double sum = 0.0;
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        sum += samples[i];
+    }
+    std::sort(samples.begin(), samples.end());
+
+    RESULT result;
+    result.name = name;
+    result.width = width;
+    result.batch = batch;
+    result.iterations = iterations;
+    result.median_ns = samples[samples.size() / 2];
+    result.p95_ns = samples[std::min(samples.size() - 1, samples.size() * 95 / 100)];
+    result.mean_ns = sum / samples.size();
+    result.min_ns = samples[0];
+    result.bytes = bytes;
+    results.push_back(result);
+
+    std::printf("%-28s %6d %6d %12.0f %12.0f %12.0f", name.c_str(), width, batch,
+                result.median_ns, result.p95_ns, result.median_ns / batch);
+    if (bytes > 0.0)
+    {
+        std::printf(" %8.1f", bytes / result.median_ns);
+    }
+    std::printf("\n");
+}
+
+/*
+ * write the results as a JSON document
+ */
+static void write_json(const std::string &path, int cpu)
+{
+    std::ofstream out(path.c_str());
+    out << "{\n  \"kernels\": \"" << kernels->name << "\",\n"
+        << "  \"precision\": \"" << (sizeof(working_t) == sizeof(float) ? "fp32" : "bf16") << "\",\n"
+        << "  \"cpu\": " << cpu << ",\n"
+        << "  \"warmup_iterations\": " << WARMUP_ITERATIONS << ",\n"
+        << "  \"results\": [\n";
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const RESULT &r = results[i];
+        out << "    {\"name\": \"" << r.name << "\", \"width\": " << r.width << ", \"batch\": " << r.batch
+            << ", \"iterations\": " << r.iterations << ", \"median_ns\": " << r.median_ns
+            << ", \"p95_ns\": " << r.p95_ns << ", \"mean_ns\": " << r.mean_ns << ", \"min_ns\": " << r.min_ns << ", \"bytes\": " << r.bytes
+            << ", \"gb_per_s\": " << (r.bytes > 0.0 ? r.bytes / r.median_ns : 0.0) << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+
+    out << "  ]\n}\n";
+}
+
+/*
+ * pin the calling thread to one CPU so the numbers do not depend on migrations
+ */
+static bool pin_to_cpu(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+/*
+ * synthetic MNIST-like pixels, a density share of them non-zero (about 20% in MNIST)
+ */
+static std::vector<uint8_t> make_pixels(size_t count, std::mt19937 &gen, float density = 0.2f)
+{
+    std::vector<uint8_t> pixels(count * BENCH_INPUTS);
+    std::uniform_int_distribution<int> value(1, 255);
+    std::uniform_real_distribution<float> coin(0.0f, 1.0f);
+    for (size_t i = 0; i < pixels.size(); i++)
+    {
+        pixels[i] = coin(gen) < density ? (uint8_t)value(gen) : 0;
+    }
+    return pixels;
+}
+
+/*
+ * write a big-endian 32-bit IDX header field
+ */
+static void write_be32(std::ofstream &out, uint32_t value)
+{
+    unsigned char bytes[4] = {(unsigned char)(value >> 24), (unsigned char)(value >> 16),
+                              (unsigned char)(value >> 8), (unsigned char)value};
+    out.write(reinterpret_cast<char *>(bytes), 4);
+}
+
+/*
+ * write a synthetic MNIST dataset in IDX format to folder
+ */
+static void write_idx_dataset(const std::string &folder, const std::vector<uint8_t> &pixels, size_t count)
+{
+    const char *prefixes[2] = {"train", "t10k"};
+    for (int f = 0; f < 2; f++)
+    {
+        std::ofstream images((folder + "/" + prefixes[f] + "-images-idx3-ubyte").c_str(), std::ios::binary);
+        write_be32(images, 0x803);
+        write_be32(images, count);
+        write_be32(images, 28);
+        write_be32(images, 28);
+        images.write(reinterpret_cast<const char *>(pixels.data()), count * BENCH_INPUTS);
+
+        std::ofstream labels((folder + "/" + prefixes[f] + "-labels-idx1-ubyte").c_str(), std::ios::binary);
+        write_be32(labels, 0x801);
+        write_be32(labels, count);
+        for (size_t i = 0; i < count; i++)
+        {
+            labels.put((char)(i % BENCH_CLASSES));
+        }
+    }
+}
+
+/*
+ * per-sample training functions for one hidden layer width
+ */
+static void bench_per_sample(int width, IDX_DATASET &dataset, THREAD_POOL &pool)
+{
+    LAYER layer;
+    LAYER output_layer;
+    layer.initialize_layer(BENCH_INPUTS, width);
+    output_layer.initialize_layer(width, BENCH_CLASSES);
+    WORKSPACE workspace;
+    workspace.initialize_workspace(BENCH_INPUTS, width, BENCH_CLASSES);
+    const float learning_rate = 1e-6f;
+
+    // first layer weight traffic: the forward pass reads the working copy,
+    // the update reads and writes the fp32 masters (and writes the bf16 copy)
+    double working_bytes = (double)width * BENCH_INPUTS * sizeof(working_t);
+    double update_bytes = (double)width * BENCH_INPUTS * 2 * sizeof(float) +
+                          (sizeof(working_t) == sizeof(float) ? 0.0 : working_bytes);
+
+    // the functions are run on a rotating set of samples
+    measure("forward_feed", width, 1, MEASURED_ITERATIONS, [&](int i)
+            { forward_feed(&layer, dataset.training_images.image(i % BENCH_SAMPLES), width); }, working_bytes);
+    measure("forward_feed_parallel", width, 1, MEASURED_ITERATIONS, [&](int i)
+            { forward_feed_parallel(&layer, dataset.training_images.image(i % BENCH_SAMPLES), width, pool); }, working_bytes);
+    measure("feed_output", width, 1, MEASURED_ITERATIONS, [&](int)
+            { feed_output(&output_layer, &layer, BENCH_CLASSES); });
+    measure("softmax", width, 1, MEASURED_ITERATIONS, [&](int)
+            { softmax(&output_layer, BENCH_CLASSES); });
+    measure("sparse_cross_entropy_loss", width, 1, MEASURED_ITERATIONS, [&](int i)
+            { volatile float loss = sparse_cross_entropy_loss(output_layer.outputs, i % BENCH_CLASSES); (void)loss; });
+    measure("backpropagate_output", width, 1, MEASURED_ITERATIONS, [&](int i)
+            { backpropagate_output(output_layer, layer, i % BENCH_CLASSES, learning_rate); });
+    measure("backpropagate_hidden", width, 1, MEASURED_ITERATIONS, [&](int i)
+            { backpropagate_hidden(layer, output_layer, dataset.training_images.image(i % BENCH_SAMPLES), learning_rate, workspace); },
+            update_bytes);
+}
+
+/*
+ * full per-sample training and prediction step, runtime widths against the compile-time network
+ */
+template <int WIDTH>
+static void bench_network(IDX_DATASET &dataset)
+{
+    LAYER layer;
+    LAYER output_layer;
+    layer.initialize_layer(BENCH_INPUTS, WIDTH);
+    output_layer.initialize_layer(WIDTH, BENCH_CLASSES);
+    WORKSPACE workspace;
+    workspace.initialize_workspace(BENCH_INPUTS, WIDTH, BENCH_CLASSES);
+    Network<BENCH_INPUTS, WIDTH, BENCH_CLASSES> network(layer, output_layer);
+    const float learning_rate = 1e-6f;
+
+    measure("train_sample", WIDTH, 1, MEASURED_ITERATIONS, [&](int i)
+            { train_sample(layer, output_layer, dataset.training_images.image(i % BENCH_SAMPLES), i % BENCH_CLASSES,
+                           learning_rate, workspace); });
+    measure("network_train", WIDTH, 1, MEASURED_ITERATIONS, [&](int i)
+            { network.train(dataset.training_images.image(i % BENCH_SAMPLES), i % BENCH_CLASSES, learning_rate); });
+    measure("predict_sample", WIDTH, 1, MEASURED_ITERATIONS, [&](int i)
+            { predict_sample(layer, output_layer, dataset.training_images.image(i % BENCH_SAMPLES), workspace); });
+    measure("network_predict", WIDTH, 1, MEASURED_ITERATIONS, [&](int i)
+            { network.predict(dataset.training_images.image(i % BENCH_SAMPLES)); });
+}
+
+/*
+ * per-sample training of the compile-time network on the dense pixel rows
+ * against the sparse lists of the same pixels, over a range of input densities
+ * SPARSE_INPUT_DENSITY is taken from where the sparse step stops being faster
+ */
+static void bench_sparse_inputs(std::mt19937 &gen)
+{
+    LAYER layer;
+    LAYER output_layer;
+    layer.initialize_layer(BENCH_INPUTS, NUM_NEURONS);
+    output_layer.initialize_layer(NUM_NEURONS, BENCH_CLASSES);
+    Network<BENCH_INPUTS, NUM_NEURONS, BENCH_CLASSES> network(layer, output_layer);
+    const float learning_rate = 1e-6f;
+
+    const int densities[] = {10, 20, 30, 50, 70, 90, 100};
+    for (size_t d = 0; d < sizeof(densities) / sizeof(densities[0]); d++)
+    {
+        std::vector<uint8_t> pixels = make_pixels(BENCH_SAMPLES, gen, densities[d] / 100.0f);
+        IMAGE_TENSOR images = {pixels.data(), BENCH_SAMPLES, 28, 28, BENCH_INPUTS};
+        SPARSE_IMAGES sparse;
+        sparse.build(images);
+        std::string suffix = "_" + std::to_string(densities[d]) + "%";
+
+        measure("network_train_dense" + suffix, NUM_NEURONS, 1, MEASURED_ITERATIONS, [&](int i)
+                { network.train(images.image(i % BENCH_SAMPLES), i % BENCH_CLASSES, learning_rate); });
+
+        // the sparse steps train the transposed weights
+        layer.load_columns();
+        measure("network_train_sparse" + suffix, NUM_NEURONS, 1, MEASURED_ITERATIONS, [&](int i)
+                { network.train(sparse.image(i % BENCH_SAMPLES), i % BENCH_CLASSES, learning_rate); });
+        layer.store_columns();
+    }
+}
+
+/*
+ * mini-batch training functions for one hidden layer width and batch size
+ */
+static void bench_batch(int width, int batch_size, IDX_DATASET &dataset)
+{
+    LAYER layer;
+    LAYER output_layer;
+    layer.initialize_layer(BENCH_INPUTS, width);
+    output_layer.initialize_layer(width, BENCH_CLASSES);
+    BATCH batch;
+    batch.initialize_batch(batch_size, BENCH_INPUTS, width, BENCH_CLASSES);
+    const float learning_rate = 1e-6f;
+    int iterations = std::max(50, MEASURED_ITERATIONS / batch_size * 4);
+
+    load_batch(batch, dataset.training(), 0, batch_size);
+
+    measure("load_batch", width, batch_size, iterations, [&](int i)
+            { load_batch(batch, dataset.training(), (i * batch_size) % (BENCH_SAMPLES - batch_size), batch_size); });
+    measure("forward_feed_batch", width, batch_size, iterations, [&](int)
+            { forward_feed_batch(&layer, batch); });
+    measure("feed_output_batch", width, batch_size, iterations, [&](int)
+            { feed_output_batch(&output_layer, batch); });
+    measure("softmax_batch", width, batch_size, iterations, [&](int)
+            { softmax_batch(batch.rows(batch.outputs)); });
+    measure("backpropagate_output_batch", width, batch_size, iterations, [&](int)
+            { backpropagate_output_batch(output_layer, batch, learning_rate); });
+    measure("backpropagate_hidden_batch", width, batch_size, iterations, [&](int)
+            { backpropagate_hidden_batch(layer, batch, learning_rate); });
+}
+
+/*
+ * fp32 and int8 inference engines for one hidden layer width
+ */
+static void bench_inference(int width, IDX_DATASET &dataset)
+{
+    LAYER layer;
+    LAYER output_layer;
+    layer.initialize_layer(BENCH_INPUTS, width);
+    output_layer.initialize_layer(width, BENCH_CLASSES);
+
+    InferenceEngine engine(layer, output_layer);
+    QuantizedInferenceEngine quantized(layer, output_layer, dataset.test_images);
+
+    // the fp32 engine takes normalized float images
+    const IMAGE_TENSOR &images = dataset.test_images;
+    std::vector<float> normalized(images.size() * BENCH_INPUTS);
+    for (size_t i = 0; i < normalized.size(); i++)
+    {
+        normalized[i] = images.data[i] * PIXEL_SCALE;
+    }
+    std::vector<int> labels(INFERENCE_BLOCK);
+
+    const int batch_sizes[] = {1, INFERENCE_BLOCK};
+    for (size_t b = 0; b < sizeof(batch_sizes) / sizeof(batch_sizes[0]); b++)
+    {
+        int batch_size = batch_sizes[b];
+        int iterations = std::max(50, MEASURED_ITERATIONS / batch_size * 4);
+        size_t blocks = BENCH_SAMPLES / batch_size;
+
+        measure("predict_fp32", width, batch_size, iterations, [&](int i)
+                { engine.predict(normalized.data() + (i % blocks) * batch_size * BENCH_INPUTS, batch_size,
+                                 labels.data(), nullptr); });
+        measure("predict_int8", width, batch_size, iterations, [&](int i)
+                { quantized.predict(images.image((i % blocks) * batch_size), batch_size, images.stride,
+                                    labels.data(), nullptr); });
+    }
+}
+
+/*
+ * map a synthetic IDX dataset and touch every image byte,
+ * then read it through the streaming reader
+ */
+static void bench_loading(const std::vector<uint8_t> &pixels)
+{
+    char folder[] = "/tmp/nn_bench_XXXXXX";
+    if (!mkdtemp(folder))
+    {
+        std::printf("could not create a temporary directory, skipping dataset loading\n");
+        return;
+    }
+    write_idx_dataset(folder, pixels, BENCH_SAMPLES);
+
+    measure("load_idx_dataset", 0, BENCH_SAMPLES, 200, [&](int)
+            {
+        IDX_DATASET dataset;
+        load_idx_dataset(folder, dataset);
+        // fold in the first pass over the pixels, mapping alone is lazy
+        unsigned int sum = 0;
+        const IMAGE_TENSOR &images = dataset.training_images;
+        for (size_t i = 0; i < images.size() * images.stride; i += 64)
+        {
+            sum += images.data[i];
+        }
+        volatile unsigned int sink = sum;
+        (void)sink; });
+
+    // one epoch through the prefetching reader, chunks small enough to exercise the double buffer
+    IDX_STREAM stream;
+    if (stream.open(std::string(folder) + "/train-images-idx3-ubyte", std::string(folder) + "/train-labels-idx1-ubyte",
+                    BENCH_SAMPLES / 8, true, 42))
+    {
+        measure("stream_idx_epoch", 0, BENCH_SAMPLES, 200, [&](int)
+                {
+            unsigned int sum = 0;
+            IDX_CHUNK chunk;
+            while (stream.next(chunk))
+            {
+                const IMAGE_TENSOR &images = chunk.samples.images;
+                for (size_t i = 0; i < images.size() * images.stride; i += 64)
+                {
+                    sum += images.data[i];
+                }
+            }
+            volatile unsigned int sink = sum;
+            (void)sink; }, (double)BENCH_SAMPLES * (BENCH_INPUTS + 1));
+    }
+
+    const char *files[4] = {"train-images-idx3-ubyte", "train-labels-idx1-ubyte",
+                            "t10k-images-idx3-ubyte", "t10k-labels-idx1-ubyte"};
+    for (int f = 0; f < 4; f++)
+    {
+        unlink((std::string(folder) + "/" + files[f]).c_str());
+    }
+    rmdir(folder);
+}
+
+int main(int argc, char **argv)
+{
+    std::string output = argc > 1 ? argv[1] : "bench_results.json";
+    int cpu = argc > 2 ? std::atoi(argv[2]) : 0;
+
+    std::mt19937 gen(42);
+    std::vector<uint8_t> pixels = make_pixels(BENCH_SAMPLES, gen);
+    std::vector<uint8_t> labels(BENCH_SAMPLES);
+    for (size_t i = 0; i < labels.size(); i++)
+    {
+        labels[i] = i % BENCH_CLASSES;
+    }
+
+    // in-memory dataset over the synthetic pixels
+    IDX_DATASET dataset;
+    IMAGE_TENSOR images = {pixels.data(), BENCH_SAMPLES, 28, 28, BENCH_INPUTS};
+    LABEL_VIEW label_view = {labels.data(), BENCH_SAMPLES};
+    dataset.training_images = dataset.test_images = images;
+    dataset.training_labels = dataset.test_labels = label_view;
+
+    // the pool workers are started before pinning so they can use the other cores
+    THREAD_POOL pool(std::thread::hardware_concurrency());
+    bool pinned = pin_to_cpu(cpu);
+
+    std::printf("kernels: %s, precision: %s, threads: %d, pinned to cpu %d: %s\n\n", kernels->name,
+                sizeof(working_t) == sizeof(float) ? "fp32" : "bf16", pool.size(), cpu, pinned ? "yes" : "no");
+    std::printf("%-28s %6s %6s %12s %12s %12s %8s\n", "function", "width", "batch", "median ns", "p95 ns", "ns/sample",
+                "GB/s");
+
+    const int widths[] = {64, 128, 256};
+    const int batch_sizes[] = {16, 64, 256};
+
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++)
+    {
+        bench_per_sample(widths[w], dataset, pool);
+    }
+
+    // the compile-time widths match the runtime ones above
+    bench_network<64>(dataset);
+    bench_network<128>(dataset);
+    bench_network<256>(dataset);
+    bench_sparse_inputs(gen);
+
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++)
+    {
+        for (size_t b = 0; b < sizeof(batch_sizes) / sizeof(batch_sizes[0]); b++)
+        {
+            bench_batch(widths[w], batch_sizes[b], dataset);
+        }
+    }
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++)
+    {
+        bench_inference(widths[w], dataset);
+    }
+    bench_loading(pixels);
+
+    write_json(output, pinned ? cpu : -1);
+    std::printf("\nresults written to %s\n", output.c_str());
+
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include "../include/gemm.hpp"
+#include "../include/kernels.hpp"
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+/*
+ * GFLOP/s of the blocked gemm for the shapes used by mini-batch training,
+ * compared with the single-core peak measured by the kernel peak probe
+ */
+
+/*
+ * fill a matrix with uniform random values
+ */
+static void randomize(MATRIX &matrix, std::mt19937 &gen)
+{
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    for (size_t i = 0; i < matrix.rows; i++)
+    {
+        for (size_t j = 0; j < matrix.cols; j++)
+        {
+            matrix(i, j) = dist(gen);
+        }
+    }
+}
+
+/*
+ * seconds elapsed since start
+ */
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/*
+ * measured single-core peak of the selected kernels in GFLOP/s
+ */
+static double peak_gflops()
+{
+    // warm up the core clock before measuring
+    kernels->peak_probe(10000000);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    double flops = kernels->peak_probe(50000000);
+    return flops / seconds_since(start) / 1e9;
+}
+
+/*
+ * best-of-five GFLOP/s for one gemm variant and shape
+ * variant is 'N' (nn), 'T' (nt) or 'G' (tn, weight gradient)
+ */
+static double gemm_gflops(char variant, size_t m, size_t n, size_t k, std::mt19937 &gen)
+{
+    MATRIX a = variant == 'G' ? MATRIX(k, m) : MATRIX(m, k);
+    MATRIX b = variant == 'T' ? MATRIX(n, k) : MATRIX(k, n);
+    MATRIX c(m, n);
+    randomize(a, gen);
+    randomize(b, gen);
+
+    // repeat small products so every measurement runs for a while
+    double flops = 2.0 * m * n * k;
+    int repeats = (int)(2e8 / flops) + 1;
+    double best = 0.0;
+
+    for (int trial = 0; trial < 5; trial++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int r = 0; r < repeats; r++)
+        {
+            if (variant == 'N')
+                gemm_nn(1.0f, a.view(), b.view(), 0.0f, c.view());
+            else if (variant == 'T')
+                gemm_nt(1.0f, a.view(), b.view(), 0.0f, c.view());
+            else
+                gemm_tn(1.0f, a.view(), b.view(), 1.0f, c.view());
+        }
+        double gflops = flops * repeats / seconds_since(start) / 1e9;
+        if (gflops > best)
+        {
+            best = gflops;
+        }
+    }
+
+    return best;
+}
+
+int main()
+{
+    std::mt19937 gen(42);
+    double peak = peak_gflops();
+
+    std::printf("kernels: %s\n", kernels->name);
+    std::printf("single-core peak: %.1f GFLOP/s\n\n", peak);
+    std::printf("%-28s %6s %6s %6s %10s %8s\n", "product", "m", "n", "k", "GFLOP/s", "of peak");
+
+    const size_t batch_sizes[] = {32, 128, 512};
+    for (size_t i = 0; i < sizeof(batch_sizes) / sizeof(batch_sizes[0]); i++)
+    {
+        size_t batch = batch_sizes[i];
+        struct
+        {
+            const char *name;
+            char variant;
+            size_t m, n, k;
+        } shapes[] = {
+            {"forward   X * W1^T   (nt)", 'T', batch, 128, 784},
+            {"output    H * W2^T   (nt)", 'T', batch, 10, 128},
+            {"error     D2 * W2    (nn)", 'N', batch, 128, 10},
+            {"gradient  D1^T * X   (tn)", 'G', 128, 784, batch},
+        };
+
+        for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++)
+        {
+            double gflops = gemm_gflops(shapes[s].variant, shapes[s].m, shapes[s].n, shapes[s].k, gen);
+            std::printf("%-28s %6zu %6zu %6zu %10.1f %7.0f%%\n", shapes[s].name,
+                        shapes[s].m, shapes[s].n, shapes[s].k, gflops, 100.0 * gflops / peak);
+        }
+        std::printf("\n");
+    }
+
+    double gflops = gemm_gflops('N', 1024, 1024, 1024, gen);
+    std::printf("%-28s %6d %6d %6d %10.1f %7.0f%%\n", "square    (nn)", 1024, 1024, 1024, gflops, 100.0 * gflops / peak);
+
+    return 0;
+}
@@ -3,6 +3,7 @@
 #include <cmath>
 #include <vector>
 #include "../include/layer.hpp"
+#include "../include/matrix.hpp"
 
 /*
  * ReLU activation for the hidden layer
@@ -12,8 +13,19 @@ float relu(float x);
 
 /*
  * softmax activation for the output layers
- * returns a vector of probabilities which sums to 1
+ * replaces the logits in layer->outputs with probabilities which sum to 1
  */
-std::vector<float> softmax(LAYER *layer, int num_classes);
+void softmax(LAYER *layer, int num_classes);
+
+/*
+ * softmax of count logits in place
+ */
+void softmax(float *values, size_t count);
+
+/*
+ * softmax activation for a batch of output rows
+ * each row of logits is replaced by its probabilities in place
+ */
+void softmax_batch(const MATRIX_VIEW &outputs);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,21 @@
+#ifndef ALLOC_COUNTER_HPP
+#define ALLOC_COUNTER_HPP
+#include <cstddef>
+
+/*
+ * counters of the replaced global operator new / delete
+ * only C++ heap allocations are counted, not malloc or posix_memalign
+ */
+struct ALLOCATION_STATS
+{
+    size_t allocations;
+    size_t deallocations;
+    size_t bytes;
+};
+
+/*
+ * snapshot of the counters since program start
+ */
+ALLOCATION_STATS allocation_stats();
+
+#endif
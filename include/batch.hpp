@@ -0,0 +1,68 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+#include <vector>
+#include "../include/matrix.hpp"
+
+/*
+ * mini-batch buffers, one row per sample
+ * allocated once for the largest batch and reused for every batch
+ */
+struct BATCH
+{
+    MATRIX inputs;         // batch x inputs
+    MATRIX hidden_outputs; // batch x neurons, ReLU activations
+    MATRIX hidden_deltas;  // batch x neurons
+    MATRIX outputs;        // batch x classes, logits and then probabilities
+    MATRIX output_deltas;  // batch x classes
+    std::vector<int> labels;
+    size_t size; // number of samples in the current batch
+
+    /*
+     * allocate the buffers for batches of up to batch_size samples
+     */
+    void initialize_batch(int batch_size, int inputs, int neurons, int classes)
+    {
+        this->inputs.resize(batch_size, inputs);
+        this->hidden_outputs.resize(batch_size, neurons);
+        this->hidden_deltas.resize(batch_size, neurons);
+        this->outputs.resize(batch_size, classes);
+        this->output_deltas.resize(batch_size, classes);
+        this->labels = std::vector<int>(batch_size, 0);
+        this->size = 0;
+    }
+
+    /*
+     * view of the first size rows of one of the batch matrices
+     */
+    MATRIX_VIEW rows(const MATRIX &matrix) const
+    {
+        MATRIX_VIEW v = matrix.view();
+        v.rows = this->size;
+        return v;
+    }
+};
+
+/*
+ * gradients of both layers summed over a slice of a batch
+ * every thread of a data-parallel step owns one set
+ */
+struct GRADIENTS
+{
+    MATRIX hidden_weights; // neurons x inputs
+    MATRIX output_weights; // classes x neurons
+    std::vector<float> hidden_biases;
+    std::vector<float> output_biases;
+
+    /*
+     * allocate the buffers for the given topology
+     */
+    void initialize_gradients(int inputs, int neurons, int classes)
+    {
+        this->hidden_weights.resize(neurons, inputs);
+        this->output_weights.resize(classes, neurons);
+        this->hidden_biases = std::vector<float>(neurons, 0.0f);
+        this->output_biases = std::vector<float>(classes, 0.0f);
+    }
+};
+
+#endif
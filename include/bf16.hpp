@@ -0,0 +1,34 @@
+#ifndef BF16_HPP
+#define BF16_HPP
+#include <cstdint>
+#include <cstring>
+
+/*
+ * bfloat16 stored as its raw bits: the upper half of an IEEE fp32 value
+ * (same exponent range as fp32, 8 bits of mantissa)
+ */
+typedef uint16_t bf16;
+
+/*
+ * round an fp32 value to the nearest bf16 (ties to even)
+ */
+inline bf16 float_to_bf16(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    bits += 0x7FFF + ((bits >> 16) & 1);
+    return (bf16)(bits >> 16);
+}
+
+/*
+ * widen a bf16 value to fp32, exact
+ */
+inline float bf16_to_float(bf16 value)
+{
+    uint32_t bits = (uint32_t)value << 16;
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "../include/layer.hpp"
+
+/*
+ * binary checkpoint layout (little-endian)
+ *
+ *   CHECKPOINT_HEADER                          64 bytes
+ *   CHECKPOINT_LAYER x num_layers              64 bytes each
+ *   per layer: weights  neurons x stride floats, the padded MATRIX rows as they are in memory
+ *              biases   neurons floats, zero padded to the alignment
+ *
+ * every block starts on a CHECKPOINT_ALIGNMENT boundary, so once the file is mapped
+ * the weight blocks can be used as MATRIX buffers directly
+ * the checksum covers the data blocks, then the header (with the checksum field zeroed)
+ * and the layer records
+ */
+#define CHECKPOINT_MAGIC "NNCKPT01"
+#define CHECKPOINT_VERSION 2
+#define CHECKPOINT_DTYPE_FLOAT32 1
+#define CHECKPOINT_ALIGNMENT MATRIX_ALIGNMENT
+
+struct CHECKPOINT_HEADER
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t dtype;
+    uint32_t alignment;
+    uint32_t num_layers;
+    uint64_t checksum;  // 64-bit FNV-1a of the data blocks, the header and the layer records
+    uint64_t file_size; // total size in bytes
+    uint8_t reserved[24];
+};
+
+struct CHECKPOINT_LAYER
+{
+    uint64_t inputs;
+    uint64_t neurons;
+    uint64_t stride;         // floats between weight rows
+    uint64_t weights_offset; // byte offset from the start of the file
+    uint64_t biases_offset;
+    uint8_t reserved[24];
+};
+
+/*
+ * read-only mapping of a checkpoint file
+ * layers loaded from it use the mapped weights, so it must outlive them
+ * the mapping is private, training a loaded model never modifies the file
+ */
+struct CHECKPOINT
+{
+    void *mapping;
+    size_t size;
+
+    CHECKPOINT() : mapping(nullptr), size(0) {}
+    ~CHECKPOINT();
+
+    CHECKPOINT(const CHECKPOINT &) = delete;
+    CHECKPOINT &operator=(const CHECKPOINT &) = delete;
+};
+
+/*
+ * write the layers to path with a single sequential write
+ * returns false and prints an error on failure
+ */
+bool save_checkpoint(const std::string &path, LAYER &layer, LAYER &output_layer);
+
+/*
+ * map the checkpoint at path and point the layers at its weights
+ * the stored topology must match the expected one
+ * returns false and prints an error on failure
+ */
+bool load_checkpoint(const std::string &path, CHECKPOINT &checkpoint, LAYER &layer, LAYER &output_layer,
+                     int num_inputs, int num_neurons, int num_classes);
+
+#endif
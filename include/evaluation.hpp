@@ -5,18 +5,68 @@
 #include <iomanip>
 #include <chrono>
 
+/*
+ * loss sum, correct count and confusion matrix over a subset of the samples
+ * every evaluation worker fills its own counts and they are merged at the end,
+ * so no predictions have to be stored
+ */
+struct EVALUATION_COUNTS
+{
+    double total_loss;
+    size_t correct;
+    size_t samples;
+    int num_classes;
+    std::vector<int> confusion; // num_classes x num_classes, row = prediction, column = true label
+
+    /*
+     *  reset the counts for num_classes classes
+     */
+    void initialize_counts(int num_classes)
+    {
+        this->total_loss = 0.0;
+        this->correct = 0;
+        this->samples = 0;
+        this->num_classes = num_classes;
+        this->confusion.assign(num_classes * num_classes, 0);
+    }
+
+    /*
+     *  count one scored sample
+     */
+    void add(int prediction, int true_label, float loss)
+    {
+        this->total_loss += loss;
+        this->correct += prediction == true_label;
+        this->samples++;
+        this->confusion[prediction * this->num_classes + true_label]++;
+    }
+
+    /*
+     *  add the counts of another worker
+     */
+    void merge(const EVALUATION_COUNTS &other)
+    {
+        this->total_loss += other.total_loss;
+        this->correct += other.correct;
+        this->samples += other.samples;
+        for (size_t i = 0; i < this->confusion.size(); i++)
+        {
+            this->confusion[i] += other.confusion[i];
+        }
+    }
+};
+
 /*
  * Evaluation struct to store evaluation metrics
  */
 struct EVALUATION
 {
     // loss variables
-    float total_loss;
-    float average_loss;
-    float current_loss;
+    double total_loss;
+    double average_loss;
     // classification variables
-    std::vector<int> predictions;
-    std::vector<int> true_labels;
+    size_t correct;
+    size_t evaluated;
     std::vector<std::vector<int>> confusion_matrix;
     // timer variables
     std::chrono::high_resolution_clock::time_point start_time;
@@ -28,28 +78,37 @@ struct EVALUATION
      */
     void initialize_loss()
     {
-        this->total_loss = 0.0f;
-        this->average_loss = 0.0f;
-        this->current_loss = 0.0f;
+        this->total_loss = 0.0;
+        this->average_loss = 0.0;
     }
 
     /*
-     *  set the predicted labels and true labels
+     *  set the loss, accuracy and confusion matrix from merged counts
      */
-    void set_labels(std::vector<int> predictions, std::vector<int> true_labels)
+    void set_counts(const EVALUATION_COUNTS &counts)
     {
-        this->predictions = predictions;
-        this->true_labels = true_labels;
+        this->total_loss = counts.total_loss;
+        this->average_loss = counts.samples ? counts.total_loss / counts.samples : 0.0;
+        this->correct = counts.correct;
+        this->evaluated = counts.samples;
+
+        this->confusion_matrix = std::vector<std::vector<int>>(counts.num_classes, std::vector<int>(counts.num_classes, 0));
+        for (int i = 0; i < counts.num_classes; ++i)
+        {
+            for (int j = 0; j < counts.num_classes; ++j)
+            {
+                this->confusion_matrix[i][j] = counts.confusion[i * counts.num_classes + j];
+            }
+        }
     }
 
     /*
-     *  set the loss for the current sample
+     *  set the loss summed over the samples of a pass
      */
-    void set_loss(float loss, int sample_index)
+    void set_loss(double total_loss, size_t num_samples)
     {
-        this->current_loss = loss;
-        this->total_loss += loss;
-        this->average_loss = (this->average_loss * sample_index + this->current_loss) / (sample_index + 1);
+        this->total_loss = total_loss;
+        this->average_loss = num_samples ? total_loss / num_samples : 0.0;
     }
 
     /*
@@ -57,40 +116,22 @@ struct EVALUATION
      */
     double accuracy()
     {
-        int correct = 0;
-        for (size_t i = 0; i < predictions.size(); ++i)
-        {
-            // check if prediction is correct
-            if (predictions[i] == true_labels[i])
-            {
-                correct++;
-            }
-        }
-        return (double)correct / predictions.size();
+        return (double)this->correct / this->evaluated;
     }
 
     /*
      *  display the confusion matrix
      *  which shows the number of correct and incorrect predictions
      */
-    void display_confusion_matrix(int num_classes)
+    void display_confusion_matrix()
     {
-        // check if predictions and true labels are the same size
-        if (predictions.size() != true_labels.size())
+        // ensure confusion matrix is populated
+        if (confusion_matrix.empty())
         {
-            std::cout << "Error: predictions and true labels are not the same size\n";
+            std::cout << "Error: confusion matrix is empty. Please compute it first.\n";
             return;
         }
 
-        // initialize confusion matrix
-        this->confusion_matrix = std::vector<std::vector<int>>(num_classes, std::vector<int>(num_classes, 0));
-
-        // fill confusion matrix
-        for (size_t i = 0; i < predictions.size(); ++i)
-        {
-            this->confusion_matrix[predictions[i]][true_labels[i]]++;
-        }
-
         // print confusion matrix
         std::cout << std::endl
                   << "Confusion matrix:\n";
@@ -170,12 +211,14 @@ struct EVALUATION
 
     /*
      * print training metrics
+     * num_samples is the number of samples processed while the timer ran
      */
-    void print_training_metrics()
+    void print_training_metrics(size_t num_samples)
     {
         std::cout << std::endl
                   << "avg.loss: " << this->average_loss
-                  << " time: " << (int)this->elapsed.count() << " ms\n"
+                  << " time: " << (int)this->elapsed.count() << " ms"
+                  << " samples/s: " << (int)(num_samples / (this->elapsed.count() / 1000.0)) << "\n"
                   << std::endl;
     }
 
@@ -198,10 +241,20 @@ struct EVALUATION
  */
 float sparse_cross_entropy_loss(std::vector<float> &softmax_output, int true_label);
 
+/*
+ * sparse cross-entropy loss for a row of probabilities
+ */
+float sparse_cross_entropy_loss(const float *softmax_output, int true_label);
+
 /*
  * find the index of the maximum value in a vector
  * used to find the predicted class
  */
 int max_value_index(std::vector<float> &vector);
 
+/*
+ * index of the maximum of count values
+ */
+int max_value_index(const float *values, int count);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,39 @@
+#ifndef GEMM_HPP
+#define GEMM_HPP
+#include "../include/matrix.hpp"
+
+/*
+ * cache blocking parameters of the gemm driver
+ * a packed GEMM_MR x GEMM_KC sliver of a stays in L1 next to one GEMM_KC x GEMM_NR sliver of b,
+ * the GEMM_MC x GEMM_KC block of a stays in L2 and the GEMM_KC x GEMM_NC block of b in L3
+ */
+#define GEMM_MC 120
+#define GEMM_KC 256
+#define GEMM_NC 2048
+
+/*
+ * general matrix-matrix products on row-major views
+ * c = alpha * op(a) * op(b) + beta * c
+ * the shape of c selects how many rows and columns are computed,
+ * so views with fewer rows can be passed for a partial batch
+ *
+ * the operands are packed into contiguous panels block by block
+ * and multiplied by the register micro-kernel of the selected KERNELS table
+ */
+
+/*
+ * c (m x n) = alpha * a (m x k) * b (k x n) + beta * c
+ */
+void gemm_nn(float alpha, const MATRIX_VIEW &a, const MATRIX_VIEW &b, float beta, const MATRIX_VIEW &c);
+
+/*
+ * c (m x n) = alpha * a (m x k) * transpose(b (n x k)) + beta * c
+ */
+void gemm_nt(float alpha, const MATRIX_VIEW &a, const MATRIX_VIEW &b, float beta, const MATRIX_VIEW &c);
+
+/*
+ * c (m x n) = alpha * transpose(a (k x m)) * b (k x n) + beta * c
+ */
+void gemm_tn(float alpha, const MATRIX_VIEW &a, const MATRIX_VIEW &b, float beta, const MATRIX_VIEW &c);
+
+#endif
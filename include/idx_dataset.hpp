@@ -0,0 +1,220 @@
+#ifndef IDX_DATASET_HPP
+#define IDX_DATASET_HPP
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// raw pixels are stored as 0-255, the first layer kernels scale them to 0-1
+#define PIXEL_SCALE (1.0f / 255.0f)
+
+// IDX magic numbers: unsigned byte data with 3 (images) or 1 (labels) dimensions
+#define IDX_IMAGES_MAGIC 0x00000803
+#define IDX_LABELS_MAGIC 0x00000801
+
+// how many samples ahead of the current one are prefetched when visiting in shuffled order
+#define PREFETCH_SAMPLES 4
+
+/*
+ * read-only memory mapping of a whole file
+ */
+struct MAPPED_FILE
+{
+    const uint8_t *data;
+    size_t size;
+
+    MAPPED_FILE() : data(nullptr), size(0) {}
+    ~MAPPED_FILE();
+
+    MAPPED_FILE(const MAPPED_FILE &) = delete;
+    MAPPED_FILE &operator=(const MAPPED_FILE &) = delete;
+
+    /*
+     * map path, returns false and prints an error on failure
+     */
+    bool map(const std::string &path);
+};
+
+/*
+ * contiguous view of count 8-bit images, image i starts at data + i * stride
+ */
+struct IMAGE_TENSOR
+{
+    const uint8_t *data;
+    size_t count;
+    size_t rows;
+    size_t columns;
+    size_t stride; // bytes between images, rows * columns for IDX files
+
+    const uint8_t *image(size_t i) const
+    {
+        return this->data + i * this->stride;
+    }
+
+    size_t size() const
+    {
+        return this->count;
+    }
+
+    size_t pixels() const
+    {
+        return this->rows * this->columns;
+    }
+
+    /*
+     * start loading image i into the cache ahead of its use
+     */
+    void prefetch(size_t i) const
+    {
+        const uint8_t *image = this->image(i);
+        for (size_t offset = 0; offset < this->stride; offset += 64)
+        {
+            __builtin_prefetch(image + offset);
+        }
+    }
+};
+
+/*
+ * view of count 8-bit labels
+ */
+struct LABEL_VIEW
+{
+    const uint8_t *data;
+    size_t count;
+
+    int operator[](size_t i) const
+    {
+        return this->data[i];
+    }
+
+    size_t size() const
+    {
+        return this->count;
+    }
+
+    /*
+     * largest label of the view, -1 when it is empty
+     */
+    int max() const
+    {
+        return this->count ? *std::max_element(this->data, this->data + this->count) : -1;
+    }
+};
+
+/*
+ * samples of a dataset without owning them, passed by value wherever samples are needed
+ * position i of the view is sample order[begin + i] of the tensor, or begin + i without an order,
+ * so slices (e.g. train/validation splits) and per-thread shards are O(1) and never copy pixels
+ */
+struct DATASET_VIEW
+{
+    IMAGE_TENSOR images;   // tensor the sample indices refer to
+    LABEL_VIEW labels;     // labels of the same samples
+    const uint32_t *order; // visiting order, nullptr for consecutive samples
+    size_t begin;
+    size_t count;
+
+    size_t size() const
+    {
+        return this->count;
+    }
+
+    size_t index(size_t i) const
+    {
+        return this->order ? this->order[this->begin + i] : this->begin + i;
+    }
+
+    /*
+     * raw pixels of the sample at position i
+     */
+    const uint8_t *input(size_t i) const
+    {
+        return this->images.image(this->index(i));
+    }
+
+    int label(size_t i) const
+    {
+        return this->labels[this->index(i)];
+    }
+
+    /*
+     * positions [start, start + count) of the view, clamped to its end
+     */
+    DATASET_VIEW slice(size_t start, size_t count) const
+    {
+        DATASET_VIEW view = *this;
+        view.begin = this->begin + std::min(start, this->count);
+        view.count = std::min(count, this->count - std::min(start, this->count));
+        return view;
+    }
+
+    /*
+     * shard of num_shards near-equal contiguous parts, the shards cover the view exactly once
+     */
+    DATASET_VIEW shard(size_t shard, size_t num_shards) const
+    {
+        size_t start = this->count * shard / num_shards;
+        size_t end = this->count * (shard + 1) / num_shards;
+        return this->slice(start, end - start);
+    }
+
+    /*
+     * start loading the sample at position i into the cache, ignored past the end
+     */
+    void prefetch(size_t i) const
+    {
+        if (i < this->count)
+        {
+            this->images.prefetch(this->index(i));
+        }
+    }
+
+    /*
+     * the samples as one tensor, only for views without an order
+     */
+    IMAGE_TENSOR tensor() const
+    {
+        IMAGE_TENSOR tensor = {this->images.image(this->begin), this->count, this->images.rows, this->images.columns,
+                               this->images.stride};
+        return tensor;
+    }
+};
+
+/*
+ * MNIST-style dataset read straight from the mapped IDX files
+ * images stay as raw bytes, nothing is copied or converted at load time
+ */
+struct IDX_DATASET
+{
+    MAPPED_FILE files[4];
+    IMAGE_TENSOR training_images;
+    IMAGE_TENSOR test_images;
+    LABEL_VIEW training_labels;
+    LABEL_VIEW test_labels;
+
+    DATASET_VIEW training() const
+    {
+        DATASET_VIEW view = {this->training_images, this->training_labels, nullptr, 0, this->training_images.size()};
+        return view;
+    }
+
+    DATASET_VIEW test() const
+    {
+        DATASET_VIEW view = {this->test_images, this->test_labels, nullptr, 0, this->test_images.size()};
+        return view;
+    }
+};
+
+/*
+ * map the four MNIST files in folder (train/t10k images and labels)
+ * returns false and prints an error on failure
+ */
+bool load_idx_dataset(const std::string &folder, IDX_DATASET &dataset);
+
+/*
+ * map only the two t10k files in folder, the training views are left empty
+ * used when the training set is streamed instead of mapped
+ */
+bool load_idx_test_set(const std::string &folder, IDX_DATASET &dataset);
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef IDX_STREAM_HPP
+#define IDX_STREAM_HPP
+#include "idx_dataset.hpp"
+#include "sparse_images.hpp"
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+// samples per chunk, a stream keeps two chunks in memory
+#define STREAM_CHUNK_SAMPLES 8192
+
+/*
+ * consecutive samples handed out by a stream
+ * the views point into the stream buffers and stay valid until the next call to next()
+ */
+struct IDX_CHUNK
+{
+    DATASET_VIEW samples;        // in visiting order
+    size_t first;                // position of the first sample within the epoch
+    const SPARSE_IMAGES *sparse; // non-zero pixels of samples.images, nullptr unless the stream builds them
+};
+
+/*
+ * streaming reader over an IDX image file and its label file
+ * a background thread reads fixed-size chunks into one of two buffers
+ * while the caller trains on the other, so memory use is bounded by two chunks
+ * whatever the size of the files, and the first chunk is ready right after open()
+ *
+ * usage: while (stream.next(chunk)) { ... } walks one epoch, next() returns false
+ * once at the end and the following call starts the next epoch from the beginning
+ *
+ * a shuffled stream visits the chunks in a new random order every epoch and hands out
+ * a random order for the samples within each chunk, the files are still read in whole chunks
+ * the orders only depend on the seed, so the same seed gives the same epochs
+ *
+ * with sparse_inputs the prefetch thread also builds the index/value lists of the non-zero pixels
+ * of every chunk it reads, so the training thread gets them without scanning the pixels
+ */
+struct IDX_STREAM
+{
+    IDX_STREAM();
+    ~IDX_STREAM();
+
+    IDX_STREAM(const IDX_STREAM &) = delete;
+    IDX_STREAM &operator=(const IDX_STREAM &) = delete;
+
+    /*
+     * open the files, check their headers and start prefetching the first epoch
+     * returns false and prints an error on failure
+     */
+    bool open(const std::string &images_path, const std::string &labels_path, size_t chunk_samples,
+              bool shuffle, unsigned int seed, bool sparse_inputs = false);
+
+    /*
+     * hand out the next chunk of the epoch, waiting for the prefetch thread if needed
+     * the previous chunk is given back to the prefetch thread
+     */
+    bool next(IDX_CHUNK &chunk);
+
+    /*
+     * true once a read has failed, the stream then ends every epoch early
+     */
+    bool failed() const
+    {
+        return this->read_failed;
+    }
+
+    size_t size() const
+    {
+        return this->count;
+    }
+
+    size_t pixels() const
+    {
+        return this->rows * this->columns;
+    }
+
+    /*
+     * largest label of the file, -1 when it is empty (the labels are scanned once by open())
+     */
+    int max_label() const
+    {
+        return this->largest_label;
+    }
+
+private:
+    std::string images_path;
+    std::string labels_path;
+    int images_fd;
+    int labels_fd;
+    size_t count;
+    size_t rows;
+    size_t columns;
+    size_t chunk_samples;
+    size_t num_chunks;
+    int largest_label;
+
+    // only used by the prefetch thread
+    bool shuffle;
+    std::mt19937 generator;
+    std::vector<size_t> chunk_order;
+
+    // double buffer, chunk c of the epoch goes to buffer c % 2
+    std::vector<uint8_t> image_buffers[2];
+    std::vector<uint8_t> label_buffers[2];
+    std::vector<uint32_t> order_buffers[2];
+    SPARSE_IMAGES sparse_buffers[2];
+    bool sparse_inputs;
+    size_t buffer_samples[2];
+    bool ready[2];
+
+    // chunk positions of the prefetch thread and of the caller, guarded by the mutex
+    size_t read_chunk;
+    size_t next_chunk;
+    size_t position;
+    bool holding;
+    bool stopping;
+    bool read_failed;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::thread prefetcher;
+
+    void prefetch_loop();
+    bool read_chunk_into(size_t chunk, int buffer);
+    bool scan_labels();
+    void close_files();
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef INFERENCE_ENGINE_HPP
+#define INFERENCE_ENGINE_HPP
+#include <cstddef>
+#include "../include/layer.hpp"
+#include "../include/matrix.hpp"
+
+// number of images pushed through the network together
+#define INFERENCE_BLOCK 64
+
+/*
+ * standalone batched predictor for the trained network
+ * holds its own read-only copy of the weights and biases and the scratch buffers
+ * for one block of images, so it does not touch the training LAYER structs after construction
+ * and needs no allocations while predicting
+ *
+ * an engine is not thread-safe, use one engine per thread
+ */
+class InferenceEngine
+{
+public:
+    /*
+     * copy the parameters of a trained hidden and output layer
+     */
+    InferenceEngine(const LAYER &hidden_layer, const LAYER &output_layer);
+
+    /*
+     * classify n images stored back to back (n x inputs floats, pixels in 0-1)
+     * labels receives n predicted classes, probs (if not null) n x classes probabilities
+     */
+    void predict(const float *images, size_t n, int *labels, float *probs);
+
+    size_t num_inputs() const
+    {
+        return this->hidden_weights.cols;
+    }
+
+    size_t num_classes() const
+    {
+        return this->output_weights.rows;
+    }
+
+private:
+    MATRIX hidden_weights; // neurons x inputs
+    MATRIX hidden_biases;  // 1 x neurons
+    MATRIX output_weights; // classes x neurons
+    MATRIX output_biases;  // 1 x classes
+    MATRIX hidden;         // INFERENCE_BLOCK x neurons scratch
+    MATRIX logits;         // 1 x classes scratch
+
+    void predict_block(const float *images, size_t count, int *labels, float *probs);
+};
+
+#endif
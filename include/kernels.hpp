@@ -0,0 +1,174 @@
+#ifndef KERNELS_HPP
+#define KERNELS_HPP
+#include <cstddef>
+#include <cstdint>
+
+// register tile of the gemm micro-kernel, shared by every instruction set
+// so the packed panel layout does not depend on the selected kernels
+#define GEMM_MR 6
+#define GEMM_NR 16
+
+// rows per call of the blocked 8-bit dot product, the vector kernels keep one register per row
+#define DOT_ROWS 4
+
+/*
+ * table of vector kernels for one instruction set
+ */
+struct KERNELS
+{
+    const char *name;
+
+    /*
+     * returns the sum of a[i] * b[i]
+     */
+    float (*dot)(const float *a, const float *b, size_t n);
+
+    /*
+     * y[i] += alpha * x[i]
+     */
+    void (*axpy)(float alpha, const float *x, float *y, size_t n);
+
+    /*
+     * returns the sum of a[i] * x[i] for raw 8-bit pixels
+     * the caller applies the pixel scale to the result
+     */
+    float (*dot_u8)(const float *a, const uint8_t *x, size_t n);
+
+    /*
+     * y[i] += alpha * x[i] for raw 8-bit pixels
+     * the pixel scale is folded into alpha by the caller
+     */
+    void (*axpy_u8)(float alpha, const uint8_t *x, float *y, size_t n);
+
+    /*
+     * sums[r] = sum of a[r * stride + i] * x[i] for DOT_ROWS consecutive rows
+     * the pixels are converted once for all the rows and every row has its own accumulator
+     */
+    void (*dot4_u8)(const float *a, size_t stride, const uint8_t *x, size_t n, float *sums);
+
+    /*
+     * y[i] = sum of values[k] * columns[indices[k] * stride + i] for i < n
+     * adds up the weight columns of the non-zero pixels of a sparse input,
+     * the caller applies the pixel scale to the result
+     */
+    void (*sum_columns_u8)(const float *columns, size_t stride, const uint16_t *indices, const uint8_t *values,
+                           size_t count, float *y, size_t n);
+
+    /*
+     * columns[indices[k] * stride + i] += alpha * values[k] * x[i] for every k and i < n
+     * touches only the weight columns of the non-zero pixels of a sparse input,
+     * the pixel scale is folded into alpha by the caller
+     */
+    void (*update_columns_u8)(float alpha, const float *x, size_t n, const uint16_t *indices, const uint8_t *values,
+                              size_t count, float *columns, size_t stride);
+
+    /*
+     * returns the sum of x[i] * w[i] for 8-bit pixels and int8 weights
+     * accumulated exactly in int32, used by the quantized inference path
+     */
+    int32_t (*dot_s8)(const uint8_t *x, const int8_t *w, size_t n);
+
+    /*
+     * returns the sum of a[i] * b[i] for bf16 values, accumulated in fp32
+     */
+    float (*dot_bf16)(const uint16_t *a, const uint16_t *b, size_t n);
+
+    /*
+     * y[i] += alpha * x[i] for raw 8-bit pixels, then y_bf16[i] = y[i] rounded to bf16
+     * updates fp32 master weights and their bf16 working copy in one pass
+     */
+    void (*axpy_u8_bf16)(float alpha, const uint8_t *x, float *y, uint16_t *y_bf16, size_t n);
+
+    /*
+     * gemm micro-kernel, c (mr x nr) += alpha * a_panel * b_panel
+     * a_panel holds k columns of GEMM_MR packed values, b_panel k rows of GEMM_NR
+     * mr and nr may be smaller than the register tile at the matrix edges
+     */
+    void (*gemm_kernel)(size_t k, float alpha, const float *a_panel, const float *b_panel,
+                        float *c, size_t ldc, size_t mr, size_t nr);
+
+    /*
+     * runs iterations rounds of independent multiply-adds that never leave the registers
+     * returns the number of floating point operations executed, used to estimate peak throughput
+     */
+    double (*peak_probe)(size_t iterations);
+};
+
+/*
+ * the kernels selected for this CPU
+ * chosen once at startup from the cpuid feature flags
+ */
+extern const KERNELS *kernels;
+
+/*
+ * portable scalar kernels, always available
+ */
+extern const KERNELS generic_kernels;
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KERNELS_X86 1
+extern const KERNELS sse2_kernels;
+extern const KERNELS avx2_kernels;
+extern const KERNELS avx512_kernels;
+extern const KERNELS avx512_vnni_kernels;
+extern const KERNELS avx512_bf16_kernels;
+#endif
+
+/*
+ * picks the widest kernel table supported by the CPU
+ */
+const KERNELS *select_kernels();
+
+inline float dot(const float *a, const float *b, size_t n)
+{
+    return kernels->dot(a, b, n);
+}
+
+inline void axpy(float alpha, const float *x, float *y, size_t n)
+{
+    kernels->axpy(alpha, x, y, n);
+}
+
+inline float dot(const float *a, const uint8_t *x, size_t n)
+{
+    return kernels->dot_u8(a, x, n);
+}
+
+inline void axpy(float alpha, const uint8_t *x, float *y, size_t n)
+{
+    kernels->axpy_u8(alpha, x, y, n);
+}
+
+inline void dot_rows(const float *a, size_t stride, const uint8_t *x, size_t n, float *sums)
+{
+    kernels->dot4_u8(a, stride, x, n, sums);
+}
+
+inline void sum_columns(const float *columns, size_t stride, const uint16_t *indices, const uint8_t *values,
+                        size_t count, float *y, size_t n)
+{
+    kernels->sum_columns_u8(columns, stride, indices, values, count, y, n);
+}
+
+inline void update_columns(float alpha, const float *x, size_t n, const uint16_t *indices, const uint8_t *values,
+                           size_t count, float *columns, size_t stride)
+{
+    kernels->update_columns_u8(alpha, x, n, indices, values, count, columns, stride);
+}
+
+inline int32_t dot(const uint8_t *x, const int8_t *w, size_t n)
+{
+    return kernels->dot_s8(x, w, n);
+}
+
+inline float dot(const uint16_t *a, const uint16_t *b, size_t n)
+{
+    return kernels->dot_bf16(a, b, n);
+}
+
+inline void axpy(float alpha, const uint8_t *x, float *y, uint16_t *y_bf16, size_t n)
+{
+    kernels->axpy_u8_bf16(alpha, x, y, y_bf16, n);
+}
+
+#endif
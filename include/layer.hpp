@@ -1,14 +1,108 @@
 #ifndef LAYER_HPP
 #define LAYER_HPP
 #include <random>
+#include <vector>
+#include <cmath>
+#include "../include/matrix.hpp"
+#include "../include/bf16.hpp"
+
+/*
+ * scalar types of the per-sample forward pass of the first layer
+ * `make PRECISION=bf16` keeps a bfloat16 copy of the weights next to the fp32 master weights
+ * and rounds the pixels to bf16 (exact for 0-255), which halves the bytes streamed per sample
+ * and uses the bf16 dot product instructions where available
+ * the products are accumulated in fp32 and the updates always go to the fp32 masters
+ */
+#ifdef PRECISION_BF16
+typedef bf16 working_t;
+typedef bf16 working_input_t;
+#else
+typedef float working_t;
+typedef uint8_t working_input_t; // the raw pixels are read in place
+#endif
 
 struct LAYER
 {
-    std::vector<std::vector<float>> weights; // 2D vector
+    MATRIX weights; // neurons x inputs, row-major and aligned
     std::vector<float> biases;
     std::vector<float> weighted_sums;
     std::vector<float> outputs;
     std::vector<float> deltas;
+    // hidden neurons left active by the ReLU in the last forward pass, each range [start, end) the pass
+    // was split into lists its own in active[start, ...), ended by -1 when shorter than the range
+    std::vector<int> active;
+    int num_active; // length of all the lists together
+#ifdef PRECISION_BF16
+    std::vector<bf16> working; // neurons x weights.stride, rounded copy of the weights
+#endif
+    std::vector<working_input_t> working_inputs; // current input in the working precision (bf16 builds only)
+    MATRIX columns; // inputs x neurons, transposed weights while training on sparse inputs
+
+    /*
+     * row i of the working weights, the fp32 weights themselves unless built for bf16
+     */
+    const working_t *working_row(size_t i) const
+    {
+#ifdef PRECISION_BF16
+        return this->working.data() + i * this->weights.stride;
+#else
+        return this->weights.row(i);
+#endif
+    }
+
+    /*
+     * round the master weights into the working copy
+     * needed after the weights were changed by anything but the per-sample updates
+     */
+    void sync_working()
+    {
+#ifdef PRECISION_BF16
+        this->working_inputs.resize(this->weights.cols);
+        this->working.resize(this->weights.rows * this->weights.stride);
+        for (size_t i = 0; i < this->weights.rows * this->weights.stride; i++)
+        {
+            this->working[i] = float_to_bf16(this->weights.data[i]);
+        }
+#endif
+    }
+
+    /*
+     * copy the weights into the transposed columns
+     * a sparse input then reads and updates one contiguous column per non-zero pixel,
+     * the columns are the master copy until store_columns()
+     */
+    void load_columns()
+    {
+        if (this->columns.rows != this->weights.cols || this->columns.cols != this->weights.rows)
+        {
+            this->columns.resize(this->weights.cols, this->weights.rows);
+        }
+        for (size_t i = 0; i < this->weights.rows; i++)
+        {
+            const float *row = this->weights.row(i);
+            for (size_t j = 0; j < this->weights.cols; j++)
+            {
+                this->columns(j, i) = row[j];
+            }
+        }
+    }
+
+    /*
+     * copy the columns back into the weights (and their working copy)
+     * needed before anything but the sparse training step reads the weights
+     */
+    void store_columns()
+    {
+        for (size_t i = 0; i < this->weights.rows; i++)
+        {
+            float *row = this->weights.row(i);
+            for (size_t j = 0; j < this->weights.cols; j++)
+            {
+                row[j] = this->columns(j, i);
+            }
+        }
+        this->sync_working();
+    }
 
     /*
      * initialize layers weights and biases
@@ -22,15 +116,16 @@ struct LAYER
         std::mt19937 gen(rd());
         std::normal_distribution<float> dist(0.0f, std::sqrt(2.0f / inputs));
 
-        // define the size of the 2D vector
-        this->weights = std::vector<std::vector<float>>(neurons, std::vector<float>(inputs));
+        // allocate the weight matrix, one padded row per neuron
+        this->weights.resize(neurons, inputs);
 
         // initialize weights
         for (int i = 0; i < neurons; ++i)
         {
+            float *row = this->weights.row(i);
             for (int j = 0; j < inputs; ++j)
             {
-                this->weights[i][j] = dist(gen);
+                row[j] = dist(gen);
             }
         }
 
@@ -39,6 +134,26 @@ struct LAYER
         this->weighted_sums = std::vector<float>(neurons, 0.0f);
         this->outputs = std::vector<float>(neurons, 0.0f);
         this->deltas = std::vector<float>(neurons, 0.0f);
+        this->active = std::vector<int>(neurons, -1);
+        this->num_active = 0;
+        this->sync_working();
+    }
+
+    /*
+     * initialize the layer from stored parameters
+     * the weights are used in place (e.g. from a mapped checkpoint), the biases are copied
+     */
+    void initialize_layer(float *weights, const float *biases, int inputs, int neurons, size_t stride)
+    {
+        this->weights.attach(weights, neurons, inputs, stride);
+
+        this->biases = std::vector<float>(biases, biases + neurons);
+        this->weighted_sums = std::vector<float>(neurons, 0.0f);
+        this->outputs = std::vector<float>(neurons, 0.0f);
+        this->deltas = std::vector<float>(neurons, 0.0f);
+        this->active = std::vector<int>(neurons, -1);
+        this->num_active = 0;
+        this->sync_working();
     }
 };
 
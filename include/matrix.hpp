@@ -0,0 +1,190 @@
+#ifndef MATRIX_HPP
+#define MATRIX_HPP
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+
+// alignment of the matrix buffer and of every row in bytes (one cache line)
+#define MATRIX_ALIGNMENT 64
+// number of floats per aligned block, row strides are rounded up to this
+#define MATRIX_PADDING (MATRIX_ALIGNMENT / sizeof(float))
+
+/*
+ * non-owning view of a row-major float matrix
+ * consecutive rows are stride floats apart (stride >= cols)
+ */
+struct MATRIX_VIEW
+{
+    float *data;
+    size_t rows;
+    size_t cols;
+    size_t stride;
+
+    /*
+     * pointer to the first element of row i
+     */
+    float *row(size_t i) const
+    {
+        return this->data + i * this->stride;
+    }
+
+    /*
+     * element at row i, column j
+     */
+    float &operator()(size_t i, size_t j) const
+    {
+        return this->data[i * this->stride + j];
+    }
+};
+
+/*
+ * row-major float matrix stored in a single 64-byte aligned buffer
+ * the leading dimension (stride) is padded to a multiple of 16 floats
+ * so every row starts on a cache line boundary, the padding is kept at zero
+ *
+ * a matrix normally owns its buffer, attach() makes it use external memory
+ * (e.g. a mapped checkpoint) which must outlive the matrix
+ */
+struct MATRIX
+{
+    float *data;
+    size_t rows;
+    size_t cols;
+    size_t stride;
+    bool owned;
+
+    MATRIX() : data(nullptr), rows(0), cols(0), stride(0), owned(true) {}
+
+    MATRIX(size_t rows, size_t cols) : data(nullptr), rows(0), cols(0), stride(0), owned(true)
+    {
+        this->resize(rows, cols);
+    }
+
+    MATRIX(const MATRIX &other) : data(nullptr), rows(0), cols(0), stride(0), owned(true)
+    {
+        this->resize(other.rows, other.cols);
+        if (other.data)
+        {
+            // an attached matrix may have a wider stride than the copy, copy row by row
+            for (size_t i = 0; i < other.rows; i++)
+            {
+                std::memcpy(this->row(i), other.row(i), other.cols * sizeof(float));
+            }
+        }
+    }
+
+    MATRIX(MATRIX &&other) : data(other.data), rows(other.rows), cols(other.cols), stride(other.stride), owned(other.owned)
+    {
+        other.data = nullptr;
+        other.rows = other.cols = other.stride = 0;
+        other.owned = true;
+    }
+
+    MATRIX &operator=(MATRIX other)
+    {
+        std::swap(this->data, other.data);
+        std::swap(this->rows, other.rows);
+        std::swap(this->cols, other.cols);
+        std::swap(this->stride, other.stride);
+        std::swap(this->owned, other.owned);
+        return *this;
+    }
+
+    ~MATRIX()
+    {
+        this->release();
+    }
+
+    /*
+     * free the buffer if the matrix owns it
+     */
+    void release()
+    {
+        if (this->owned)
+        {
+            std::free(this->data);
+        }
+        this->data = nullptr;
+        this->owned = true;
+    }
+
+    /*
+     * use an external buffer without copying it
+     * the buffer must be 64-byte aligned and hold rows x stride floats
+     */
+    void attach(float *data, size_t rows, size_t cols, size_t stride)
+    {
+        this->release();
+        this->data = data;
+        this->rows = rows;
+        this->cols = cols;
+        this->stride = stride;
+        this->owned = false;
+    }
+
+    /*
+     * round a column count up to the padded leading dimension
+     */
+    static size_t padded_stride(size_t cols)
+    {
+        return (cols + MATRIX_PADDING - 1) / MATRIX_PADDING * MATRIX_PADDING;
+    }
+
+    /*
+     * reallocate the buffer for the given shape and fill it with zeros
+     */
+    void resize(size_t rows, size_t cols)
+    {
+        this->release();
+        this->rows = rows;
+        this->cols = cols;
+        this->stride = padded_stride(cols);
+
+        size_t bytes = rows * this->stride * sizeof(float);
+        if (bytes == 0)
+        {
+            return;
+        }
+
+        void *buffer = nullptr;
+        if (posix_memalign(&buffer, MATRIX_ALIGNMENT, bytes) != 0)
+        {
+            throw std::bad_alloc();
+        }
+        std::memset(buffer, 0, bytes);
+        this->data = static_cast<float *>(buffer);
+    }
+
+    float *row(size_t i)
+    {
+        return this->data + i * this->stride;
+    }
+
+    const float *row(size_t i) const
+    {
+        return this->data + i * this->stride;
+    }
+
+    float &operator()(size_t i, size_t j)
+    {
+        return this->data[i * this->stride + j];
+    }
+
+    float operator()(size_t i, size_t j) const
+    {
+        return this->data[i * this->stride + j];
+    }
+
+    /*
+     * non-owning view of the whole matrix
+     */
+    MATRIX_VIEW view() const
+    {
+        MATRIX_VIEW v = {this->data, this->rows, this->cols, this->stride};
+        return v;
+    }
+};
+
+#endif
@@ -0,0 +1,209 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+#include "perf_counters.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// log2 latency buckets per phase, bucket b counts durations of [2^(b-1), 2^b) ticks
+#define HISTOGRAM_BUCKETS 48
+
+/*
+ * phases of the training loop and of the evaluation that are timed separately
+ * a step that fuses several phases (hogwild, data-parallel batches) is timed as PHASE_TRAIN_STEP
+ */
+enum PHASE
+{
+    PHASE_STREAM_WAIT,
+    PHASE_LOAD_BATCH,
+    PHASE_FORWARD_FEED,
+    PHASE_FEED_OUTPUT,
+    PHASE_SOFTMAX,
+    PHASE_LOSS,
+    PHASE_BACKPROPAGATE_OUTPUT,
+    PHASE_BACKPROPAGATE_HIDDEN,
+    PHASE_TRAIN_STEP,
+    PHASE_PREDICT,
+    PHASE_SCORE,
+    NUM_PHASES
+};
+
+/*
+ * total time, number of calls and latency histogram of one phase, in ticks
+ * with the hardware counters open, also the events counted inside the phase
+ */
+struct PHASE_STATS
+{
+    uint64_t ticks;
+    uint64_t calls;
+    uint64_t samples; // samples processed by the timed calls, 0 for per-chunk phases
+    uint64_t histogram[HISTOGRAM_BUCKETS];
+    uint64_t counters[NUM_COUNTERS];
+};
+
+/*
+ * one epoch (or evaluation pass) as reported to the metrics file
+ */
+struct RUN_METRICS
+{
+    int epoch; // 0 for the evaluation
+    size_t samples;
+    double time_ms;
+    double average_loss;
+    double accuracy; // evaluation only
+};
+
+/*
+ * metrics collected over the whole run
+ * the phase timers only exist when built with make METRICS=1 (ENABLE_METRICS),
+ * otherwise TIME_PHASE expands to nothing and only the epoch totals are kept
+ *
+ * the phases are recorded from the thread driving the training loop only,
+ * so with several threads the counters only see the share of the calling thread
+ */
+struct METRICS
+{
+    PHASE_STATS phases[NUM_PHASES];
+    std::vector<RUN_METRICS> epochs;
+    RUN_METRICS evaluation;
+    bool evaluated;
+    double flops_per_sample; // training step, forward and backward pass
+    int batch_size;
+    int threads;
+    PERF_COUNTERS counters;
+
+    // tick counter and clock at startup, the tick rate is calibrated against the clock when reporting
+    uint64_t start_ticks;
+    std::chrono::steady_clock::time_point start_time;
+
+    METRICS();
+};
+
+extern METRICS metrics;
+
+/*
+ * cheap monotonic tick counter (the TSC on x86, nanoseconds elsewhere)
+ */
+inline uint64_t read_ticks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/*
+ * add one timed call of a phase
+ */
+inline void record_phase(PHASE phase, uint64_t ticks, uint64_t samples)
+{
+    PHASE_STATS &stats = metrics.phases[phase];
+    stats.ticks += ticks;
+    stats.calls++;
+    stats.samples += samples;
+
+    // bucket by the bit length of the duration
+    int bucket = ticks ? 64 - __builtin_clzll(ticks) : 0;
+    stats.histogram[bucket < HISTOGRAM_BUCKETS ? bucket : HISTOGRAM_BUCKETS - 1]++;
+}
+
+/*
+ * times the enclosing scope as one call of a phase covering samples samples
+ * the counters are read outside of the ticks so the read() calls are not timed
+ */
+struct SCOPED_TIMER
+{
+    PHASE phase;
+    uint64_t samples;
+    bool active;
+    uint64_t start;
+    uint64_t counters[NUM_COUNTERS];
+
+    SCOPED_TIMER(PHASE phase, uint64_t samples, bool active) : phase(phase), samples(samples), active(active), start(0)
+    {
+        if (!this->active)
+        {
+            return;
+        }
+        if (metrics.counters.enabled())
+        {
+            metrics.counters.read(this->counters);
+        }
+        this->start = read_ticks();
+    }
+
+    ~SCOPED_TIMER()
+    {
+        if (!this->active)
+        {
+            return;
+        }
+        uint64_t ticks = read_ticks() - this->start;
+        record_phase(this->phase, ticks, this->samples);
+
+        if (metrics.counters.enabled())
+        {
+            uint64_t end[NUM_COUNTERS];
+            metrics.counters.read(end);
+            for (int c = 0; c < NUM_COUNTERS; c++)
+            {
+                metrics.phases[this->phase].counters[c] += end[c] - this->counters[c];
+            }
+        }
+    }
+};
+
+#define METRICS_CONCAT_(a, b) a##b
+#define METRICS_CONCAT(a, b) METRICS_CONCAT_(a, b)
+
+/*
+ * TIME_PHASE counts one sample per call, TIME_PHASE_SAMPLES the given number (a batch or a chunk)
+ * and TIME_PHASE_IF only times the calls where the condition holds (the calling thread's worker)
+ */
+#ifdef ENABLE_METRICS
+#define TIME_PHASE_SAMPLES(phase, samples) SCOPED_TIMER METRICS_CONCAT(phase_timer_, __LINE__)(phase, samples, true)
+#define TIME_PHASE_IF(condition, phase) SCOPED_TIMER METRICS_CONCAT(phase_timer_, __LINE__)(phase, 1, condition)
+#else
+#define TIME_PHASE_SAMPLES(phase, samples)
+#define TIME_PHASE_IF(condition, phase)
+#endif
+#define TIME_PHASE(phase) TIME_PHASE_SAMPLES(phase, 1)
+
+/*
+ * floating point operations of one training step of an inputs-neurons-classes network
+ * (forward pass, error propagation and both weight updates, 2 per multiply-add)
+ */
+double training_flops(size_t inputs, size_t neurons, size_t classes);
+
+/*
+ * record a finished epoch or evaluation pass
+ */
+void record_epoch(int epoch, size_t samples, double time_ms, double average_loss);
+void record_evaluation(size_t samples, double time_ms, double average_loss, double accuracy);
+
+/*
+ * open the hardware counters read around every timed phase (make METRICS=1 builds only)
+ * falls back to the phase times when no counter is available
+ */
+void open_counters();
+
+/*
+ * print the time share, call count and latency percentiles of every timed phase,
+ * followed by IPC and events per sample when the hardware counters are open
+ */
+void print_phase_metrics();
+
+/*
+ * write the collected metrics as a JSON document
+ * returns false and prints an error on failure
+ */
+bool write_metrics(const std::string &path);
+
+#endif
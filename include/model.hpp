@@ -3,17 +3,34 @@
 #include "../evaluation.hpp"
 #include "../training.hpp"
 #include "../progress_bar.hpp"
+#include "../idx_stream.hpp"
 
 /**
  * trains the model using the training dataset
+ * the samples are read from the stream one chunk at a time
+ * a batch_size above 1 enables mini-batch training with one weight update per batch
+ * returns false when a read of the training files failed, the layers are then only partly trained
  */
-void model_train(mnist::MNIST_dataset<std::vector, std::vector<float>, int> dataset, LAYER &layer,
-                 LAYER &output_layer, EVALUATION eval, int num_epochs, int num_neurons, int num_classes, float learning_rate, int parallel);
+bool model_train(IDX_STREAM &training, LAYER &layer,
+                 LAYER &output_layer, EVALUATION &eval, int num_epochs, int num_neurons, int num_classes, float learning_rate,
+                 int batch_size, THREAD_POOL &pool);
+
+/*
+ * trains the model with hogwild-style asynchronous SGD
+ * every thread of the pool trains on a disjoint slice of each chunk with its own
+ * activations and applies its updates to the shared layers without any locking
+ * returns false when a read of the training files failed, as model_train
+ */
+bool model_train_hogwild(IDX_STREAM &training, LAYER &layer,
+                         LAYER &output_layer, EVALUATION &eval, int num_epochs, int num_neurons, int num_classes,
+                         float learning_rate, THREAD_POOL &pool);
 
 /*
  * evaluates model by using the validation dataset
+ * the samples are sharded across the threads of the pool, each thread keeps its own
+ * loss sum and confusion matrix and the counts are merged at the end
  */
-void model_evaluate(mnist::MNIST_dataset<std::vector, std::vector<float>, int> dataset, LAYER &layer,
-                    LAYER &output_layer, EVALUATION eval, int num_neurons, int num_classes, int parallel);
+void model_evaluate(const DATASET_VIEW &test, LAYER &layer,
+                    LAYER &output_layer, EVALUATION &eval, int num_neurons, int num_classes, THREAD_POOL &pool);
 
 #endif
\ No newline at end of file
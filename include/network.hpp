@@ -0,0 +1,294 @@
+#ifndef NETWORK_HPP
+#define NETWORK_HPP
+#include "../include/layer.hpp"
+#include "../include/kernels.hpp"
+#include "../include/activation.hpp"
+#include "../include/evaluation.hpp"
+#include "../include/idx_dataset.hpp"
+#include "../include/sparse_images.hpp"
+
+// topology of the network trained by main
+#define NUM_INPUTS 784
+#define NUM_NEURONS 128
+#define NUM_OUTPUT_NEURONS 10
+
+/*
+ * per-sample forward and backward pass of a network whose widths are known at compile time
+ * the parameters stay in the LAYER structs (so mapped checkpoints and hogwild workers share them),
+ * the activations live in fixed-size aligned arrays inside the object
+ *
+ * with the widths as constants every loop bound and row stride is known to the compiler,
+ * the output layer loops are fully unrolled and the hidden layer is fed DOT_ROWS neurons
+ * per kernel call, which converts each pixel once for all of them
+ *
+ * the math is the same as train_sample / predict_sample, only the summation order of the
+ * hidden layer dot products differs, layers of any other shape use those runtime functions
+ *
+ * sparse inputs (the non-zero pixels only) are trained on the transposed hidden weights,
+ * see LAYER::load_columns(), which must be loaded for the whole run of sparse steps
+ *
+ * the forward pass lists the hidden neurons the ReLU leaves active, the others have a zero delta
+ * so the backward pass neither sums their errors nor touches their weights
+ *
+ * a network is not thread-safe, every worker constructs its own over the shared layers
+ */
+template <int INPUTS, int NEURONS, int CLASSES>
+class Network
+{
+    static_assert(NEURONS % DOT_ROWS == 0, "the hidden layer is fed DOT_ROWS neurons at a time");
+
+public:
+    // padded leading dimensions of the two weight matrices
+    static const size_t INPUT_STRIDE = (INPUTS + MATRIX_PADDING - 1) / MATRIX_PADDING * MATRIX_PADDING;
+    static const size_t HIDDEN_STRIDE = (NEURONS + MATRIX_PADDING - 1) / MATRIX_PADDING * MATRIX_PADDING;
+
+    Network(LAYER &hidden_layer, LAYER &output_layer) : hidden_layer(hidden_layer), output_layer(output_layer) {}
+
+    /*
+     * true when the layers have exactly the widths and strides of this instantiation
+     */
+    static bool matches(const LAYER &hidden_layer, const LAYER &output_layer)
+    {
+        return hidden_layer.weights.rows == NEURONS && hidden_layer.weights.cols == INPUTS &&
+               hidden_layer.weights.stride == INPUT_STRIDE && output_layer.weights.rows == CLASSES &&
+               output_layer.weights.cols == NEURONS && output_layer.weights.stride == HIDDEN_STRIDE;
+    }
+
+    /*
+     * weighted sums and ReLU activations of the hidden layer, the pixels are scaled to 0-1 in the kernel
+     */
+    void forward_feed(const uint8_t *input)
+    {
+        const float *biases = this->hidden_layer.biases.data();
+
+#ifdef PRECISION_BF16
+        for (int j = 0; j < INPUTS; j++)
+        {
+            this->working_inputs[j] = float_to_bf16(input[j]);
+        }
+        this->num_active = 0;
+        for (int i = 0; i < NEURONS; i++)
+        {
+            float sum = dot(this->hidden_layer.working_row(i), this->working_inputs, INPUTS);
+            this->activate(i, sum * PIXEL_SCALE + biases[i]);
+        }
+#else
+        const float *weights = this->hidden_layer.weights.data;
+        this->num_active = 0;
+        for (int i = 0; i < NEURONS; i += DOT_ROWS)
+        {
+            float sums[DOT_ROWS];
+            dot_rows(weights + i * INPUT_STRIDE, INPUT_STRIDE, input, INPUTS, sums);
+            for (int r = 0; r < DOT_ROWS; r++)
+            {
+                this->activate(i + r, sums[r] * PIXEL_SCALE + biases[i + r]);
+            }
+        }
+#endif
+    }
+
+    /*
+     * hidden layer of a sparse input, only the weight columns of the non-zero pixels are read
+     */
+    void forward_feed(const SPARSE_INPUT &input)
+    {
+        const float *biases = this->hidden_layer.biases.data();
+
+        sum_columns(this->hidden_layer.columns.data, HIDDEN_STRIDE, input.indices, input.values, input.count,
+                    this->hidden_outputs, NEURONS);
+        this->num_active = 0;
+        for (int i = 0; i < NEURONS; i++)
+        {
+            this->activate(i, this->hidden_outputs[i] * PIXEL_SCALE + biases[i]);
+        }
+    }
+
+    /*
+     * hidden neurons left active by the ReLU in the last forward pass
+     */
+    int active_neurons() const
+    {
+        return this->num_active;
+    }
+
+    /*
+     * logits of the output layer
+     */
+    void feed_output()
+    {
+        const float *weights = this->output_layer.weights.data;
+        const float *biases = this->output_layer.biases.data();
+
+        for (int c = 0; c < CLASSES; c++)
+        {
+            this->output_outputs[c] = dot(weights + c * HIDDEN_STRIDE, this->hidden_outputs, NEURONS) + biases[c];
+        }
+    }
+
+    void softmax()
+    {
+        ::softmax(this->output_outputs, CLASSES);
+    }
+
+    float loss(int expected_class) const
+    {
+        return sparse_cross_entropy_loss(this->output_outputs, expected_class);
+    }
+
+    /*
+     * output deltas and the update of the output layer
+     */
+    void backpropagate_output(int expected_class, float learning_rate)
+    {
+        float *weights = this->output_layer.weights.data;
+        float *biases = this->output_layer.biases.data();
+
+        for (int c = 0; c < CLASSES; c++)
+        {
+            this->output_deltas[c] = this->output_outputs[c] - (c == expected_class ? 1.0f : 0.0f);
+            axpy(-learning_rate * this->output_deltas[c], this->hidden_outputs, weights + c * HIDDEN_STRIDE, NEURONS);
+            biases[c] -= learning_rate * this->output_deltas[c];
+        }
+    }
+
+    /*
+     * hidden errors through the (updated) output weights and the update of the active hidden neurons
+     */
+    void backpropagate_hidden(const uint8_t *input, float learning_rate)
+    {
+        float *biases = this->hidden_layer.biases.data();
+
+        this->active_errors();
+        for (int k = 0; k < this->num_active; k++)
+        {
+            int i = this->active[k];
+            float delta = this->hidden_errors[i];
+            float *row = this->hidden_layer.weights.data + i * INPUT_STRIDE;
+
+            // the pixel scale is folded into the step, the bf16 working copy is refreshed in the same pass
+#ifdef PRECISION_BF16
+            axpy(-learning_rate * delta * PIXEL_SCALE, input, row, this->hidden_layer.working.data() + i * INPUT_STRIDE,
+                 INPUTS);
+#else
+            axpy(-learning_rate * delta * PIXEL_SCALE, input, row, INPUTS);
+#endif
+            biases[i] -= learning_rate * delta;
+        }
+    }
+
+    /*
+     * hidden update of a sparse input, the columns of the zero pixels would only get zero steps
+     * a column holds every neuron, so the inactive ones are kept in it with a zero delta
+     */
+    void backpropagate_hidden(const SPARSE_INPUT &input, float learning_rate)
+    {
+        float *biases = this->hidden_layer.biases.data();
+
+        for (int i = 0; i < NEURONS; i++)
+        {
+            this->hidden_errors[i] = 0.0f;
+        }
+        this->active_errors();
+        for (int k = 0; k < this->num_active; k++)
+        {
+            int i = this->active[k];
+            biases[i] -= learning_rate * this->hidden_errors[i];
+        }
+        update_columns(-learning_rate * PIXEL_SCALE, this->hidden_errors, NEURONS, input.indices, input.values,
+                       input.count, this->hidden_layer.columns.data, HIDDEN_STRIDE);
+    }
+
+    /*
+     * class probabilities of one sample, left in probabilities()
+     */
+    void predict(const uint8_t *input)
+    {
+        this->forward_feed(input);
+        this->feed_output();
+        this->softmax();
+    }
+
+    /*
+     * one full training step, returns the loss of the sample
+     */
+    float train(const uint8_t *input, int expected_class, float learning_rate)
+    {
+        this->predict(input);
+        float loss = this->loss(expected_class);
+        this->backpropagate_output(expected_class, learning_rate);
+        this->backpropagate_hidden(input, learning_rate);
+        return loss;
+    }
+
+    /*
+     * training step of a sparse input, returns the loss of the sample
+     */
+    float train(const SPARSE_INPUT &input, int expected_class, float learning_rate)
+    {
+        this->forward_feed(input);
+        this->feed_output();
+        this->softmax();
+        float loss = this->loss(expected_class);
+        this->backpropagate_output(expected_class, learning_rate);
+        this->backpropagate_hidden(input, learning_rate);
+        return loss;
+    }
+
+    const float *probabilities() const
+    {
+        return this->output_outputs;
+    }
+
+private:
+    LAYER &hidden_layer;
+    LAYER &output_layer;
+
+    /*
+     * ReLU of one hidden neuron, appended to the active list when positive (without a branch)
+     */
+    void activate(int i, float sum)
+    {
+        this->hidden_outputs[i] = relu(sum);
+        this->active[this->num_active] = i;
+        this->num_active += sum > 0.0f;
+    }
+
+    /*
+     * errors of the active hidden neurons through the output weights (their deltas), left in hidden_errors
+     * summed along the output weight rows so the reads stay contiguous, the inactive neurons are not read
+     */
+    void active_errors()
+    {
+        const float *weights = this->output_layer.weights.data;
+
+        for (int k = 0; k < this->num_active; k++)
+        {
+            this->hidden_errors[this->active[k]] = 0.0f;
+        }
+        for (int c = 0; c < CLASSES; c++)
+        {
+            const float *row = weights + c * HIDDEN_STRIDE;
+            for (int k = 0; k < this->num_active; k++)
+            {
+                this->hidden_errors[this->active[k]] += this->output_deltas[c] * row[this->active[k]];
+            }
+        }
+    }
+
+    alignas(MATRIX_ALIGNMENT) float hidden_outputs[NEURONS];
+    alignas(MATRIX_ALIGNMENT) float hidden_errors[NEURONS];
+    alignas(MATRIX_ALIGNMENT) float output_outputs[CLASSES];
+    alignas(MATRIX_ALIGNMENT) float output_deltas[CLASSES];
+    int active[NEURONS];
+    int num_active;
+#ifdef PRECISION_BF16
+    alignas(MATRIX_ALIGNMENT) bf16 working_inputs[INPUTS];
+#endif
+};
+
+/*
+ * the specialized instantiation used for the topology of main
+ */
+typedef Network<NUM_INPUTS, NUM_NEURONS, NUM_OUTPUT_NEURONS> MNIST_NETWORK;
+
+#endif
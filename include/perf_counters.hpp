@@ -0,0 +1,76 @@
+#ifndef PERF_COUNTERS_HPP
+#define PERF_COUNTERS_HPP
+#include <cstdint>
+
+/*
+ * hardware events counted around the timed phases
+ */
+enum COUNTER
+{
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_L1D_MISSES,
+    COUNTER_LLC_MISSES,
+    COUNTER_BRANCH_MISSES,
+    NUM_COUNTERS
+};
+
+extern const char *counter_names[NUM_COUNTERS];
+
+/*
+ * group of Linux perf_event_open counters of the calling thread (user space only)
+ * the events are opened as one group so a single read() returns all of them at the same instant
+ *
+ * events the CPU or the kernel does not offer are left out of the group, and when none
+ * can be opened (no PMU in a VM, perf_event_paranoid, seccomp in containers) the group
+ * stays disabled and every read returns zeros
+ */
+struct PERF_COUNTERS
+{
+    PERF_COUNTERS();
+    ~PERF_COUNTERS();
+
+    PERF_COUNTERS(const PERF_COUNTERS &) = delete;
+    PERF_COUNTERS &operator=(const PERF_COUNTERS &) = delete;
+
+    /*
+     * open the counters for the calling thread and start counting
+     * returns false and prints why when no counter is available
+     */
+    bool open();
+
+    void close();
+
+    bool enabled() const
+    {
+        return this->num_open > 0;
+    }
+
+    bool available(int counter) const
+    {
+        return this->fds[counter] >= 0;
+    }
+
+    /*
+     * true once a read saw the group sharing the PMU with other events,
+     * the counts then only cover the time the group was scheduled
+     */
+    bool multiplexed() const
+    {
+        return this->was_multiplexed;
+    }
+
+    /*
+     * current value of every counter, unavailable counters read as zero
+     */
+    void read(uint64_t *values);
+
+private:
+    int fds[NUM_COUNTERS];
+    int leader;
+    int num_open;
+    int order[NUM_COUNTERS]; // counter of the n-th value in a group read
+    bool was_multiplexed;
+};
+
+#endif
@@ -1,11 +1,90 @@
 #ifndef PROGRESS_BAR_HPP
 #define PROGRESS_BAR_HPP
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
 
 #define NO_EPOCHS 0
 
+// milliseconds between two redraws of the progress line
+#define PROGRESS_REFRESH_MS 100
+
 /**
  * display a progress bar
+ * the counts are 64-bit and the fraction is taken in double, so streamed passes beyond 2^31 samples draw correctly
+ */
+void progress_bar(uint64_t progress, uint64_t total, int epoch);
+
+// one cache line, the alignment of a worker's slot
+#define PROGRESS_SLOT_ALIGNMENT 64
+
+/*
+ * counters published by one training worker
+ * aligned (and so padded) to a cache line so workers do not share the line they write
  */
-void progress_bar(int progress, int total, int epoch);
+struct alignas(PROGRESS_SLOT_ALIGNMENT) PROGRESS_SLOT
+{
+    std::atomic<uint64_t> samples;
+    std::atomic<double> loss_sum;
+};
+
+/*
+ * renders the progress of a pass from a background thread
+ * the training loop only publishes its sample count and loss sum with relaxed stores,
+ * the reporter reads them every PROGRESS_REFRESH_MS and draws the bar, samples/s, ETA and running loss,
+ * so the terminal output and the averaging never run on the training thread
+ * the thread is started with the reporter and waits between passes, so a pass does not allocate
+ * (unless the number of slots changes)
+ *
+ * usage: start() before the pass, publish() from the workers, stop() after it
+ */
+struct PROGRESS_REPORTER
+{
+    PROGRESS_REPORTER();
+    ~PROGRESS_REPORTER();
+
+    PROGRESS_REPORTER(const PROGRESS_REPORTER &) = delete;
+    PROGRESS_REPORTER &operator=(const PROGRESS_REPORTER &) = delete;
+
+    /*
+     * reset the counters of num_slots workers and start drawing a pass over total samples
+     */
+    void start(size_t total, int epoch, int num_slots);
+
+    /*
+     * end the pass, returns once the reporter thread has drawn its final state
+     */
+    void stop();
+
+    /*
+     * totals so far of worker slot, samples done and the sum of their losses
+     */
+    void publish(int slot, uint64_t samples, double loss_sum)
+    {
+        this->slots[slot].samples.store(samples, std::memory_order_relaxed);
+        this->slots[slot].loss_sum.store(loss_sum, std::memory_order_relaxed);
+    }
+
+private:
+    PROGRESS_SLOT *slots; // aligned allocation, new[] only guarantees 16 bytes before C++17
+    int num_slots;
+    size_t total;
+    int epoch;
+    std::chrono::steady_clock::time_point start_time;
+
+    bool active;  // a pass is being drawn
+    bool drawn;   // the final state of the last pass was drawn
+    bool exiting; // the reporter thread should return
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::thread reporter;
+
+    void report_loop();
+    void draw();
+};
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,66 @@
+#ifndef QUANTIZED_ENGINE_HPP
+#define QUANTIZED_ENGINE_HPP
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "../include/layer.hpp"
+#include "../include/matrix.hpp"
+#include "../include/idx_dataset.hpp"
+
+// number of calibration images used to choose the per-row scales
+#define CALIBRATION_SAMPLES 512
+// fractions of the largest absolute weight tried as the int8 clipping range of a row
+#define CALIBRATION_CLIPS {1.0f, 0.9f, 0.8f, 0.7f, 0.6f, 0.5f}
+
+/*
+ * post-training int8 predictor for the trained network
+ * the hidden layer weights are quantized to int8 with one scale per neuron and multiplied
+ * with the raw 8-bit pixels in int32 (VNNI where available), the small output layer stays fp32
+ *
+ * each row's scale is calibrated on sample images: the clipping range with the lowest
+ * squared error of the weighted sums is kept, so a few outlier weights don't cost precision
+ *
+ * like InferenceEngine it holds its own copy of the parameters and its scratch buffers,
+ * so it is not thread-safe, use one engine per thread
+ */
+class QuantizedInferenceEngine
+{
+public:
+    /*
+     * quantize the parameters of a trained hidden and output layer
+     * calibration holds the images used to choose the scales
+     */
+    QuantizedInferenceEngine(const LAYER &hidden_layer, const LAYER &output_layer, const IMAGE_TENSOR &calibration);
+
+    /*
+     * classify n images of raw pixels, consecutive images are image_stride bytes apart
+     * labels receives n predicted classes, probs (if not null) n x classes probabilities
+     */
+    void predict(const uint8_t *images, size_t n, size_t image_stride, int *labels, float *probs);
+
+    size_t num_inputs() const
+    {
+        return this->inputs;
+    }
+
+    size_t num_classes() const
+    {
+        return this->output_weights.rows;
+    }
+
+private:
+    size_t inputs;
+    size_t neurons;
+    size_t stride;                      // bytes per quantized row, padded to a cache line
+    std::vector<int8_t> hidden_weights; // neurons x stride
+    std::vector<float> row_scales;      // dequantization scale per neuron, pixel scale included
+    std::vector<float> hidden_biases;
+    MATRIX output_weights; // classes x neurons, fp32
+    std::vector<float> output_biases;
+    std::vector<float> hidden; // neurons scratch
+    std::vector<float> logits; // classes scratch
+
+    void calibrate_row(size_t row, const float *weights, const IMAGE_TENSOR &calibration, size_t samples);
+};
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef SPARSE_IMAGES_HPP
+#define SPARSE_IMAGES_HPP
+#include "idx_dataset.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// chunks with a larger share of non-zero pixels are trained on the dense weight rows,
+// measured with `make bench` (network_train_sparse_N% against network_train_dense_N%):
+// the lists stay ahead up to about 75%, the margin covers transposing the weights
+#define SPARSE_INPUT_DENSITY 0.7
+
+// the pixel positions are stored as 16-bit indices
+#define SPARSE_MAX_PIXELS 65536
+
+/*
+ * non-zero pixels of one image, value k sits at pixel indices[k]
+ */
+struct SPARSE_INPUT
+{
+    const uint16_t *indices;
+    const uint8_t *values;
+    size_t count;
+};
+
+/*
+ * index/value lists of the non-zero pixels of every image of a tensor (compressed rows)
+ * image i owns entries [offsets[i], offsets[i + 1]), the positions are ascending
+ * built once when the images are loaded, the buffers keep their capacity for the next build
+ */
+struct SPARSE_IMAGES
+{
+    std::vector<uint32_t> offsets;
+    std::vector<uint16_t> indices;
+    std::vector<uint8_t> values;
+    size_t pixels; // per image
+
+    SPARSE_IMAGES() : pixels(0) {}
+
+    /*
+     * replace the lists with the non-zero pixels of images
+     * returns false when the images are too large for 16-bit indices
+     */
+    bool build(const IMAGE_TENSOR &images);
+
+    /*
+     * make room for the lists of count fully dense images, so no later build() of as many images allocates
+     * the untouched part of the buffers is never paged in
+     */
+    void reserve(size_t count, size_t pixels)
+    {
+        this->offsets.reserve(count + 1);
+        this->indices.reserve(count * pixels);
+        this->values.reserve(count * pixels);
+    }
+
+    SPARSE_INPUT image(size_t i) const
+    {
+        SPARSE_INPUT input = {this->indices.data() + this->offsets[i], this->values.data() + this->offsets[i],
+                              this->offsets[i + 1] - this->offsets[i]};
+        return input;
+    }
+
+    size_t size() const
+    {
+        return this->offsets.empty() ? 0 : this->offsets.size() - 1;
+    }
+
+    /*
+     * share of non-zero pixels over all the images
+     */
+    double density() const
+    {
+        return this->size() ? (double)this->indices.size() / ((double)this->size() * this->pixels) : 1.0;
+    }
+
+    /*
+     * start loading the lists of image i into the cache ahead of their use
+     */
+    void prefetch(size_t i) const
+    {
+        __builtin_prefetch(this->indices.data() + this->offsets[i]);
+        __builtin_prefetch(this->values.data() + this->offsets[i]);
+    }
+};
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// number of polling iterations before a waiting thread parks on the condition variable
+#define SPIN_LIMIT 20000
+
+/*
+ * reusable barrier for a fixed number of threads
+ * waiting threads spin for a short while (the common case when work is balanced)
+ * and then park on a condition variable so idle workers don't burn a core
+ */
+struct SPIN_BARRIER
+{
+    int count;
+    int spin_limit;
+    std::atomic<int> waiting;
+    std::atomic<unsigned int> generation;
+    std::mutex mutex;
+    std::condition_variable condition;
+
+    SPIN_BARRIER(int count, int spin_limit);
+
+    /*
+     * block until all threads have called wait for the current generation
+     */
+    void wait();
+};
+
+/*
+ * persistent pool of worker threads
+ * the calling thread takes part in every parallel_for, so a pool of N threads
+ * owns N - 1 workers and a pool of one thread runs everything inline
+ */
+struct THREAD_POOL
+{
+    explicit THREAD_POOL(int num_threads);
+    ~THREAD_POOL();
+
+    THREAD_POOL(const THREAD_POOL &) = delete;
+    THREAD_POOL &operator=(const THREAD_POOL &) = delete;
+
+    /*
+     * number of threads taking part in a parallel_for (workers + caller)
+     */
+    int size() const
+    {
+        return this->num_threads;
+    }
+
+    /*
+     * split [begin, end) into one contiguous chunk per thread
+     * and call fn(chunk_begin, chunk_end) on each of them
+     * returns when every chunk has been processed
+     */
+    template <typename Function>
+    void parallel_for(int begin, int end, const Function &fn)
+    {
+        if (this->num_threads == 1 || end - begin <= 1)
+        {
+            if (begin < end)
+            {
+                fn(begin, end);
+            }
+            return;
+        }
+
+        // type-erase the callable without a heap allocation
+        this->job_context = &fn;
+        this->job_invoke = &invoke<Function>;
+        this->job_begin = begin;
+        this->job_end = end;
+
+        this->run_job();
+    }
+
+private:
+    int num_threads;
+    std::vector<std::thread> workers;
+    SPIN_BARRIER start_barrier;
+    SPIN_BARRIER end_barrier;
+    bool stopping;
+
+    // current job, published to the workers by the start barrier
+    const void *job_context;
+    void (*job_invoke)(const void *, int, int);
+    int job_begin;
+    int job_end;
+
+    template <typename Function>
+    static void invoke(const void *context, int begin, int end)
+    {
+        (*static_cast<const Function *>(context))(begin, end);
+    }
+
+    void run_job();
+    void run_chunk(int thread_index);
+    void worker_loop(int thread_index);
+};
+
+#endif
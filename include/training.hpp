@@ -1,14 +1,16 @@
 #ifndef TRAINING_HPP
 #define TRAINING_HPP
-#include "../mnist/mnist_reader.hpp"
+#include "../idx_dataset.hpp"
 #include "../activation.hpp"
+#include "../thread_pool.hpp"
+#include "../batch.hpp"
+#include "../workspace.hpp"
 
 /*
  * computes the weighted sums for the neurons in the layer
+ * the raw pixels are scaled to 0-1 inside the kernel
  */
-void forward_feed(LAYER *layer,
-                  const std::vector<std::vector<float>> &images,
-                  int sample_index, int neurons);
+void forward_feed(LAYER *layer, const uint8_t *pixels, int neurons);
 
 /*
  * computes the weighted sums for the neurons in the output layer
@@ -16,11 +18,9 @@ void forward_feed(LAYER *layer,
 void feed_output(LAYER *layer, LAYER *input_layer, int neurons);
 
 /*
- * uses parallel computing to compute the weighted sums for the neurons in the layer
+ * uses the thread pool to compute the weighted sums for the neurons in the layer
  */
-void forward_feed_parallel(LAYER *layer,
-                           const std::vector<std::vector<float>> &images,
-                           int sample_index, int neurons);
+void forward_feed_parallel(LAYER *layer, const uint8_t *pixels, int neurons, THREAD_POOL &pool);
 
 /*
  * backpropagate the output layer
@@ -28,11 +28,94 @@ void forward_feed_parallel(LAYER *layer,
  */
 void backpropagate_output(LAYER &layer, LAYER &input_layer, int expected_class, float learning_rate);
 
+/*
+ * uses the thread pool to backpropagate the output layer
+ */
+void backpropagate_output_parallel(LAYER &layer, LAYER &input_layer, int expected_class, float learning_rate,
+                                   THREAD_POOL &pool);
+
 /*
  * backpropagate the hidden layer
  * update the weights and biases based on the error
+ * input is the raw pixel row that was fed forward, the errors and deltas are kept in the workspace
+ */
+void backpropagate_hidden(LAYER &layer, LAYER &next_layer, const uint8_t *input, float learning_rate,
+                          WORKSPACE &workspace);
+
+/*
+ * uses the thread pool to backpropagate the hidden layer
+ * the neurons are split across the threads for both the errors and the updates
+ */
+void backpropagate_hidden_parallel(LAYER &layer, LAYER &next_layer, const uint8_t *input,
+                                   float learning_rate, WORKSPACE &workspace, THREAD_POOL &pool);
+
+/*
+ * forward pass for a single sample with the activations kept in the workspace
+ * the class probabilities are left in workspace.output_outputs, the layers are only read,
+ * so workers with their own workspace can evaluate the same layers concurrently
+ */
+void predict_sample(const LAYER &layer, const LAYER &output_layer, const uint8_t *input, WORKSPACE &workspace);
+
+/*
+ * one full training step for a single sample with the activations kept in the workspace
+ * the layers are only read for their parameters, so workers with their own workspace
+ * can train the same layers concurrently (hogwild), returns the loss of the sample
+ */
+float train_sample(LAYER &layer, LAYER &output_layer, const uint8_t *input,
+                   int expected_class, float learning_rate, WORKSPACE &workspace);
+
+/*
+ * copies the samples at positions [start, start + count) of the view into the batch
+ * the raw pixels are scaled to 0-1 on the way
+ */
+void load_batch(BATCH &batch, const DATASET_VIEW &samples, size_t start, size_t count);
+
+/*
+ * computes the hidden layer activations for every sample in the batch
+ * as one matrix product (inputs x transposed weights)
+ */
+void forward_feed_batch(LAYER *layer, BATCH &batch);
+
+/*
+ * computes the output layer logits for every sample in the batch
+ */
+void feed_output_batch(LAYER *layer, BATCH &batch);
+
+/*
+ * backpropagate the output layer for a whole batch
+ * the weights and biases are updated once with the summed gradients
+ * the hidden errors are computed first through the weights from before the update
+ * and left in the batch, as in compute_gradients_batch
+ */
+void backpropagate_output_batch(LAYER &layer, BATCH &batch, float learning_rate);
+
+/*
+ * backpropagate the hidden layer for a whole batch, after backpropagate_output_batch
+ * the weights and biases are updated once with the summed gradients
+ */
+void backpropagate_hidden_batch(LAYER &layer, BATCH &batch, float learning_rate);
+
+/*
+ * forward and backward pass for rows [begin, end) of the loaded batch
+ * the summed gradients of both layers are written to gradients, the weights are not changed
+ */
+void compute_gradients_batch(LAYER &layer, LAYER &output_layer, BATCH &batch,
+                             size_t begin, size_t end, GRADIENTS &gradients);
+
+/*
+ * sum the gradients of every thread and apply them to both layers in one update
+ * the rows of the weight matrices are split across the threads of the pool (reduce-scatter)
+ * and the buffers are always summed in the same order, so the result is deterministic
+ */
+void apply_gradients(LAYER &layer, LAYER &output_layer, std::vector<GRADIENTS> &gradients, float learning_rate,
+                     THREAD_POOL &pool);
+
+/*
+ * synchronous data-parallel training step for the loaded batch
+ * the batch is split into one slice per gradient buffer, the slices are computed
+ * on the threads of the pool and their gradients are applied together
  */
-void backpropagate_hidden(LAYER &layer, LAYER &next_layer,
-                          const mnist::MNIST_dataset<std::vector, std::vector<float>, int> &dataset, int sample_index, float learning_rate);
+void train_batch_parallel(LAYER &layer, LAYER &output_layer, BATCH &batch, std::vector<GRADIENTS> &gradients,
+                          float learning_rate, THREAD_POOL &pool);
 
-#endif
\ No newline at end of file
+#endif
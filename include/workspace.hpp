@@ -0,0 +1,99 @@
+#ifndef WORKSPACE_HPP
+#define WORKSPACE_HPP
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include "../include/matrix.hpp"
+#include "../include/layer.hpp"
+
+/*
+ * scratch memory for one training step
+ * a single aligned arena is sized once from the topology and carved into
+ * the step temporaries, so the training loop never touches the heap
+ */
+struct WORKSPACE
+{
+    float *arena;
+    size_t capacity; // floats in the arena
+    size_t used;     // floats handed out so far
+
+    // temporaries of backpropagate_hidden, one value per hidden neuron
+    float *hidden_deltas;
+
+    // private activations, used when several workers share one set of layers
+    float *hidden_outputs;
+    int *active_neurons; // hidden neurons left active by the ReLU, listed like LAYER::active
+    int num_active;      // length of the list
+    float *output_outputs;
+    float *output_deltas;
+    working_input_t *working_inputs; // input in the working precision (bf16 builds only)
+
+    WORKSPACE()
+        : arena(nullptr), capacity(0), used(0), hidden_deltas(nullptr), hidden_outputs(nullptr),
+          active_neurons(nullptr), num_active(0), output_outputs(nullptr), output_deltas(nullptr), working_inputs(nullptr) {}
+
+    WORKSPACE(const WORKSPACE &) = delete;
+    WORKSPACE &operator=(const WORKSPACE &) = delete;
+
+    ~WORKSPACE()
+    {
+        std::free(this->arena);
+    }
+
+    /*
+     * size the arena for the given layer widths and carve the buffers
+     */
+    void initialize_workspace(int inputs, int neurons, int classes)
+    {
+        // the converted input only needs space when it is not read from the pixels in place
+        size_t input_floats = sizeof(working_input_t) > 1 ? (inputs * sizeof(working_input_t) + sizeof(float) - 1) / sizeof(float) : 0;
+
+        this->reserve(3 * MATRIX::padded_stride(neurons) + 2 * MATRIX::padded_stride(classes) +
+                      MATRIX::padded_stride(input_floats));
+        static_assert(sizeof(int) == sizeof(float), "the active list is carved from the float arena");
+        this->hidden_deltas = this->allocate(neurons);
+        this->hidden_outputs = this->allocate(neurons);
+        this->active_neurons = reinterpret_cast<int *>(this->allocate(neurons));
+        this->output_outputs = this->allocate(classes);
+        this->output_deltas = this->allocate(classes);
+        this->working_inputs = reinterpret_cast<working_input_t *>(this->allocate(input_floats));
+    }
+
+    /*
+     * replace the arena with a zeroed one of count floats
+     */
+    void reserve(size_t count)
+    {
+        std::free(this->arena);
+        this->arena = nullptr;
+        this->capacity = 0;
+        this->used = 0;
+
+        void *buffer = nullptr;
+        if (posix_memalign(&buffer, MATRIX_ALIGNMENT, count * sizeof(float)) != 0)
+        {
+            throw std::bad_alloc();
+        }
+        std::memset(buffer, 0, count * sizeof(float));
+        this->arena = static_cast<float *>(buffer);
+        this->capacity = count;
+    }
+
+    /*
+     * hand out count floats from the arena, every block starts on a cache line
+     */
+    float *allocate(size_t count)
+    {
+        size_t padded = MATRIX::padded_stride(count);
+        if (this->used + padded > this->capacity)
+        {
+            throw std::bad_alloc();
+        }
+        float *block = this->arena + this->used;
+        this->used += padded;
+        return block;
+    }
+};
+
+#endif
@@ -6,32 +6,36 @@ float relu(float x)
     return fmax(0, x);
 }
 
-std::vector<float> softmax(LAYER *layer, int num_classes)
+void softmax(float *values, size_t count)
 {
-    // initialize output vector
-    std::vector<float> output(num_classes, 0.0f);
+    // find the maximum value for numerical stability
+    float max_value = *std::max_element(values, values + count);
 
-    // find the maximum value in the outputs for numerical stability
-    float max_value = *std::max_element(layer->outputs.begin(), layer->outputs.end());
-
-    // compute exponentiated values and accumulate their sum
-    float sum_exp = 0.0;
-    for (int i = 0; i < num_classes; ++i)
+    // exponentiate (subtracting the max for stability) and accumulate the sum
+    float sum_exp = 0.0f;
+    for (size_t i = 0; i < count; i++)
     {
-        // subtract max for stability
-        float exp_value = std::exp(layer->outputs[i] - max_value);
-        // store the exponentiated value in the output
-        output[i] = exp_value;
-        // accumulate the sum of exponentiated values
-        sum_exp += exp_value;
+        values[i] = std::exp(values[i] - max_value);
+        sum_exp += values[i];
     }
 
     // normalize the exponentiated values (to get probabilities)
-    for (size_t i = 0; i < output.size(); ++i)
+    float inverse = 1.0f / sum_exp;
+    for (size_t i = 0; i < count; i++)
     {
-        // normalize each value by the sum of exponentiated values
-        output[i] /= sum_exp;
+        values[i] *= inverse;
     }
+}
+
+void softmax(LAYER *layer, int num_classes)
+{
+    softmax(layer->outputs.data(), num_classes);
+}
 
-    return output;
-}
\ No newline at end of file
+void softmax_batch(const MATRIX_VIEW &outputs)
+{
+    for (size_t r = 0; r < outputs.rows; r++)
+    {
+        softmax(outputs.row(r), outputs.cols);
+    }
+}
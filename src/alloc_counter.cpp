@@ -0,0 +1,79 @@
+#include "../include/alloc_counter.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// relaxed counters, they are only read for reporting
+static std::atomic<size_t> allocation_count(0);
+static std::atomic<size_t> deallocation_count(0);
+static std::atomic<size_t> allocated_bytes(0);
+
+static void *counted_allocate(std::size_t size)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+static void counted_free(void *pointer)
+{
+    if (pointer)
+    {
+        deallocation_count.fetch_add(1, std::memory_order_relaxed);
+        std::free(pointer);
+    }
+}
+
+void *operator new(std::size_t size)
+{
+    void *pointer = counted_allocate(size);
+    if (!pointer)
+    {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    return counted_allocate(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return counted_allocate(size);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    counted_free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+    counted_free(pointer);
+}
+
+void operator delete(void *pointer, const std::nothrow_t &) noexcept
+{
+    counted_free(pointer);
+}
+
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept
+{
+    counted_free(pointer);
+}
+
+ALLOCATION_STATS allocation_stats()
+{
+    ALLOCATION_STATS stats;
+    stats.allocations = allocation_count.load(std::memory_order_relaxed);
+    stats.deallocations = deallocation_count.load(std::memory_order_relaxed);
+    stats.bytes = allocated_bytes.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,215 @@
+#include "../include/checkpoint.hpp"
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define CHECKPOINT_LAYERS 2
+
+static_assert(sizeof(CHECKPOINT_HEADER) == 64, "checkpoint header must be 64 bytes");
+static_assert(sizeof(CHECKPOINT_LAYER) == 64, "checkpoint layer record must be 64 bytes");
+
+CHECKPOINT::~CHECKPOINT()
+{
+    if (this->mapping)
+    {
+        munmap(this->mapping, this->size);
+    }
+}
+
+/*
+ * round a byte count up to the checkpoint alignment
+ */
+static uint64_t align_up(uint64_t bytes)
+{
+    return (bytes + CHECKPOINT_ALIGNMENT - 1) / CHECKPOINT_ALIGNMENT * CHECKPOINT_ALIGNMENT;
+}
+
+/*
+ * 64-bit FNV-1a, continued from hash
+ */
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+#define FNV1A_OFFSET 14695981039346656037ULL
+
+/*
+ * continue the checksum of the data blocks over the header (with the checksum field zeroed) and the records
+ */
+static uint64_t checksum_metadata(uint64_t hash, const CHECKPOINT_HEADER &header, const CHECKPOINT_LAYER *records)
+{
+    CHECKPOINT_HEADER unsigned_header = header;
+    unsigned_header.checksum = 0;
+    hash = fnv1a(hash, &unsigned_header, sizeof(unsigned_header));
+    return fnv1a(hash, records, CHECKPOINT_LAYERS * sizeof(CHECKPOINT_LAYER));
+}
+
+bool save_checkpoint(const std::string &path, LAYER &layer, LAYER &output_layer)
+{
+    LAYER *layers[CHECKPOINT_LAYERS] = {&layer, &output_layer};
+    static const char zeros[CHECKPOINT_ALIGNMENT] = {};
+
+    CHECKPOINT_HEADER header;
+    CHECKPOINT_LAYER records[CHECKPOINT_LAYERS];
+    std::memset(&header, 0, sizeof(header));
+    std::memset(records, 0, sizeof(records));
+
+    // lay out the blocks and collect them for a single gathered write
+    struct iovec blocks[2 + 4 * CHECKPOINT_LAYERS];
+    int num_blocks = 0;
+    blocks[num_blocks++] = {&header, sizeof(header)};
+    blocks[num_blocks++] = {records, sizeof(records)};
+
+    uint64_t offset = sizeof(header) + sizeof(records);
+    uint64_t checksum = FNV1A_OFFSET;
+
+    for (int l = 0; l < CHECKPOINT_LAYERS; l++)
+    {
+        const MATRIX &weights = layers[l]->weights;
+        uint64_t weight_bytes = weights.rows * weights.stride * sizeof(float);
+        uint64_t bias_bytes = weights.rows * sizeof(float);
+        uint64_t bias_padding = align_up(bias_bytes) - bias_bytes;
+
+        records[l].inputs = weights.cols;
+        records[l].neurons = weights.rows;
+        records[l].stride = weights.stride;
+        records[l].weights_offset = offset;
+        records[l].biases_offset = offset + weight_bytes;
+
+        // the matrix rows are already padded to the alignment
+        blocks[num_blocks++] = {weights.data, weight_bytes};
+        blocks[num_blocks++] = {layers[l]->biases.data(), bias_bytes};
+        blocks[num_blocks++] = {const_cast<char *>(zeros), bias_padding};
+
+        checksum = fnv1a(checksum, weights.data, weight_bytes);
+        checksum = fnv1a(checksum, layers[l]->biases.data(), bias_bytes);
+        checksum = fnv1a(checksum, zeros, bias_padding);
+
+        offset += weight_bytes + bias_bytes + bias_padding;
+    }
+
+    std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.dtype = CHECKPOINT_DTYPE_FLOAT32;
+    header.alignment = CHECKPOINT_ALIGNMENT;
+    header.num_layers = CHECKPOINT_LAYERS;
+    header.file_size = offset;
+    header.checksum = checksum_metadata(checksum, header, records);
+
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        std::cout << "Error: could not open checkpoint file " << path << " for writing\n";
+        return false;
+    }
+
+    // one gathered write for the whole file
+    bool ok = writev(fd, blocks, num_blocks) == (ssize_t)offset;
+
+    if (close(fd) != 0 || !ok)
+    {
+        std::cout << "Error: could not write checkpoint file " << path << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+bool load_checkpoint(const std::string &path, CHECKPOINT &checkpoint, LAYER &layer, LAYER &output_layer,
+                     int num_inputs, int num_neurons, int num_classes)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cout << "Error: could not open checkpoint file " << path << "\n";
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(CHECKPOINT_HEADER) + CHECKPOINT_LAYERS * sizeof(CHECKPOINT_LAYER))
+    {
+        std::cout << "Error: checkpoint file " << path << " is too small\n";
+        close(fd);
+        return false;
+    }
+
+    // private writable mapping: the weights can be trained further without touching the file
+    void *mapping = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        std::cout << "Error: could not map checkpoint file " << path << "\n";
+        return false;
+    }
+
+    checkpoint.mapping = mapping;
+    checkpoint.size = info.st_size;
+
+    char *base = static_cast<char *>(mapping);
+    const CHECKPOINT_HEADER *header = reinterpret_cast<const CHECKPOINT_HEADER *>(base);
+    const CHECKPOINT_LAYER *records = reinterpret_cast<const CHECKPOINT_LAYER *>(base + sizeof(CHECKPOINT_HEADER));
+
+    if (std::memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != CHECKPOINT_VERSION || header->dtype != CHECKPOINT_DTYPE_FLOAT32 ||
+        header->alignment != CHECKPOINT_ALIGNMENT || header->num_layers != CHECKPOINT_LAYERS ||
+        header->file_size != (uint64_t)info.st_size)
+    {
+        std::cout << "Error: " << path << " is not a compatible checkpoint file\n";
+        return false;
+    }
+
+    // check the stored topology against the network being built
+    const uint64_t expected[CHECKPOINT_LAYERS][2] = {{(uint64_t)num_inputs, (uint64_t)num_neurons},
+                                                     {(uint64_t)num_neurons, (uint64_t)num_classes}};
+    uint64_t data_start = sizeof(CHECKPOINT_HEADER) + CHECKPOINT_LAYERS * sizeof(CHECKPOINT_LAYER);
+
+    for (int l = 0; l < CHECKPOINT_LAYERS; l++)
+    {
+        const CHECKPOINT_LAYER &record = records[l];
+        if (record.inputs != expected[l][0] || record.neurons != expected[l][1])
+        {
+            std::cout << "Error: checkpoint topology does not match the network\n";
+            return false;
+        }
+
+        // the layers are used with the stride of their MATRIX, which copies them with that stride
+        if (record.stride != MATRIX::padded_stride(record.inputs) || record.weights_offset % CHECKPOINT_ALIGNMENT != 0 ||
+            record.weights_offset < data_start ||
+            record.weights_offset + record.neurons * record.stride * sizeof(float) > header->file_size ||
+            record.biases_offset + record.neurons * sizeof(float) > header->file_size)
+        {
+            std::cout << "Error: checkpoint file " << path << " is corrupted\n";
+            return false;
+        }
+    }
+
+    uint64_t checksum = fnv1a(FNV1A_OFFSET, base + data_start, header->file_size - data_start);
+    if (checksum_metadata(checksum, *header, records) != header->checksum)
+    {
+        std::cout << "Error: checkpoint checksum mismatch, file " << path << " is corrupted\n";
+        return false;
+    }
+
+    // use the mapped weight blocks in place
+    LAYER *layers[CHECKPOINT_LAYERS] = {&layer, &output_layer};
+    for (int l = 0; l < CHECKPOINT_LAYERS; l++)
+    {
+        const CHECKPOINT_LAYER &record = records[l];
+        layers[l]->initialize_layer(reinterpret_cast<float *>(base + record.weights_offset),
+                                    reinterpret_cast<const float *>(base + record.biases_offset),
+                                    record.inputs, record.neurons, record.stride);
+    }
+
+    return true;
+}
@@ -2,6 +2,11 @@
 #include <cmath>
 
 float sparse_cross_entropy_loss(std::vector<float> &softmax_output, int true_label)
+{
+    return sparse_cross_entropy_loss(softmax_output.data(), true_label);
+}
+
+float sparse_cross_entropy_loss(const float *softmax_output, int true_label)
 {
     // get the predicted probability for the true class
     float predicted_probability = softmax_output[true_label];
@@ -31,4 +36,18 @@ int max_value_index(std::vector<float> &vector)
     }
 
     return max_index;
-}
\ No newline at end of file
+}
+
+int max_value_index(const float *values, int count)
+{
+    int max_index = 0;
+    for (int i = 1; i < count; ++i)
+    {
+        if (values[i] > values[max_index])
+        {
+            max_index = i;
+        }
+    }
+
+    return max_index;
+}
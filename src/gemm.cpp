@@ -0,0 +1,163 @@
+#include "../include/gemm.hpp"
+#include "../include/kernels.hpp"
+#include <algorithm>
+
+/*
+ * scale c by beta before the products are accumulated into it
+ */
+static void scale_output(float beta, const MATRIX_VIEW &c)
+{
+    if (beta == 1.0f)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < c.rows; i++)
+    {
+        float *row = c.row(i);
+        for (size_t j = 0; j < c.cols; j++)
+        {
+            row[j] = beta == 0.0f ? 0.0f : row[j] * beta;
+        }
+    }
+}
+
+/*
+ * make sure a packing buffer holds at least size floats
+ */
+static float *reserve_buffer(MATRIX &buffer, size_t size)
+{
+    if (buffer.cols < size)
+    {
+        buffer.resize(1, size);
+    }
+    return buffer.data;
+}
+
+/*
+ * pack the mc x kc block of op(a) starting at (i0, p0) into GEMM_MR row slivers
+ * each sliver stores kc columns of GEMM_MR values, rows past the edge are zero
+ */
+static void pack_a(const MATRIX_VIEW &a, bool transpose, size_t i0, size_t mc, size_t p0, size_t kc, float *packed)
+{
+    for (size_t ir = 0; ir < mc; ir += GEMM_MR)
+    {
+        size_t mr = std::min((size_t)GEMM_MR, mc - ir);
+
+        for (size_t p = 0; p < kc; p++)
+        {
+            for (size_t i = 0; i < GEMM_MR; i++)
+            {
+                float value = 0.0f;
+                if (i < mr)
+                {
+                    value = transpose ? a(p0 + p, i0 + ir + i) : a(i0 + ir + i, p0 + p);
+                }
+                packed[p * GEMM_MR + i] = value;
+            }
+        }
+
+        packed += kc * GEMM_MR;
+    }
+}
+
+/*
+ * pack the kc x nc block of op(b) starting at (p0, j0) into GEMM_NR column slivers
+ * each sliver stores kc rows of GEMM_NR values, columns past the edge are zero
+ */
+static void pack_b(const MATRIX_VIEW &b, bool transpose, size_t p0, size_t kc, size_t j0, size_t nc, float *packed)
+{
+    for (size_t jr = 0; jr < nc; jr += GEMM_NR)
+    {
+        size_t nr = std::min((size_t)GEMM_NR, nc - jr);
+
+        for (size_t p = 0; p < kc; p++)
+        {
+            for (size_t j = 0; j < GEMM_NR; j++)
+            {
+                float value = 0.0f;
+                if (j < nr)
+                {
+                    value = transpose ? b(j0 + jr + j, p0 + p) : b(p0 + p, j0 + jr + j);
+                }
+                packed[p * GEMM_NR + j] = value;
+            }
+        }
+
+        packed += kc * GEMM_NR;
+    }
+}
+
+/*
+ * blocked driver shared by the three variants
+ */
+static void gemm(float alpha, const MATRIX_VIEW &a, bool transpose_a, const MATRIX_VIEW &b, bool transpose_b,
+                 float beta, const MATRIX_VIEW &c)
+{
+    size_t m = c.rows;
+    size_t n = c.cols;
+    size_t k = transpose_a ? a.rows : a.cols;
+
+    scale_output(beta, c);
+
+    if (m == 0 || n == 0 || k == 0 || alpha == 0.0f)
+    {
+        return;
+    }
+
+    // packing buffers are kept per thread and only grow
+    thread_local MATRIX a_buffer;
+    thread_local MATRIX b_buffer;
+    size_t mc_max = (std::min(m, (size_t)GEMM_MC) + GEMM_MR - 1) / GEMM_MR * GEMM_MR;
+    size_t nc_max = (std::min(n, (size_t)GEMM_NC) + GEMM_NR - 1) / GEMM_NR * GEMM_NR;
+    float *packed_a = reserve_buffer(a_buffer, mc_max * GEMM_KC);
+    float *packed_b = reserve_buffer(b_buffer, nc_max * GEMM_KC);
+
+    for (size_t jc = 0; jc < n; jc += GEMM_NC)
+    {
+        size_t nc = std::min((size_t)GEMM_NC, n - jc);
+
+        for (size_t pc = 0; pc < k; pc += GEMM_KC)
+        {
+            size_t kc = std::min((size_t)GEMM_KC, k - pc);
+            pack_b(b, transpose_b, pc, kc, jc, nc, packed_b);
+
+            for (size_t ic = 0; ic < m; ic += GEMM_MC)
+            {
+                size_t mc = std::min((size_t)GEMM_MC, m - ic);
+                pack_a(a, transpose_a, ic, mc, pc, kc, packed_a);
+
+                // walk the register tiles of the block
+                for (size_t jr = 0; jr < nc; jr += GEMM_NR)
+                {
+                    size_t nr = std::min((size_t)GEMM_NR, nc - jr);
+                    const float *b_panel = packed_b + jr * kc;
+
+                    for (size_t ir = 0; ir < mc; ir += GEMM_MR)
+                    {
+                        size_t mr = std::min((size_t)GEMM_MR, mc - ir);
+                        const float *a_panel = packed_a + ir * kc;
+
+                        kernels->gemm_kernel(kc, alpha, a_panel, b_panel,
+                                             c.row(ic + ir) + jc + jr, c.stride, mr, nr);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void gemm_nn(float alpha, const MATRIX_VIEW &a, const MATRIX_VIEW &b, float beta, const MATRIX_VIEW &c)
+{
+    gemm(alpha, a, false, b, false, beta, c);
+}
+
+void gemm_nt(float alpha, const MATRIX_VIEW &a, const MATRIX_VIEW &b, float beta, const MATRIX_VIEW &c)
+{
+    gemm(alpha, a, false, b, true, beta, c);
+}
+
+void gemm_tn(float alpha, const MATRIX_VIEW &a, const MATRIX_VIEW &b, float beta, const MATRIX_VIEW &c)
+{
+    gemm(alpha, a, true, b, false, beta, c);
+}
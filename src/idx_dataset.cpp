@@ -0,0 +1,159 @@
+#include "../include/idx_dataset.hpp"
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MAPPED_FILE::~MAPPED_FILE()
+{
+    if (this->data)
+    {
+        munmap(const_cast<uint8_t *>(this->data), this->size);
+    }
+}
+
+bool MAPPED_FILE::map(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cout << "Error opening file " << path << std::endl;
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        std::cout << "Error reading file " << path << std::endl;
+        close(fd);
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        std::cout << "Error mapping file " << path << std::endl;
+        return false;
+    }
+
+    // ask the kernel to start reading the whole file in the background
+    madvise(mapping, info.st_size, MADV_WILLNEED);
+
+    this->data = static_cast<const uint8_t *>(mapping);
+    this->size = info.st_size;
+    return true;
+}
+
+/*
+ * read the big-endian 32-bit header field at position
+ */
+static uint64_t read_header(const MAPPED_FILE &file, size_t position)
+{
+    const uint8_t *bytes = file.data + position * 4;
+    return ((uint64_t)bytes[0] << 24) | ((uint64_t)bytes[1] << 16) | ((uint64_t)bytes[2] << 8) | (uint64_t)bytes[3];
+}
+
+/*
+ * map an IDX image file and describe it as a tensor
+ */
+static bool map_images(const std::string &path, MAPPED_FILE &file, IMAGE_TENSOR &images)
+{
+    if (!file.map(path))
+    {
+        return false;
+    }
+
+    if (file.size < 16 || read_header(file, 0) != IDX_IMAGES_MAGIC)
+    {
+        std::cout << "Invalid magic number, probably not a MNIST file" << std::endl;
+        return false;
+    }
+
+    images.count = read_header(file, 1);
+    images.rows = read_header(file, 2);
+    images.columns = read_header(file, 3);
+    images.stride = images.rows * images.columns;
+    images.data = file.data + 16;
+
+    // 64-bit arithmetic, the product overflows 32 bits for large corpora
+    if (file.size < 16 + images.count * images.stride)
+    {
+        std::cout << "The file is not large enough to hold all the data, probably corrupted" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * map an IDX label file and describe it as a view
+ */
+static bool map_labels(const std::string &path, MAPPED_FILE &file, LABEL_VIEW &labels)
+{
+    if (!file.map(path))
+    {
+        return false;
+    }
+
+    if (file.size < 8 || read_header(file, 0) != IDX_LABELS_MAGIC)
+    {
+        std::cout << "Invalid magic number, probably not a MNIST file" << std::endl;
+        return false;
+    }
+
+    labels.count = read_header(file, 1);
+    labels.data = file.data + 8;
+
+    if (file.size < 8 + labels.count)
+    {
+        std::cout << "The file is not large enough to hold all the data, probably corrupted" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool load_idx_dataset(const std::string &folder, IDX_DATASET &dataset)
+{
+    if (!map_images(folder + "/train-images-idx3-ubyte", dataset.files[0], dataset.training_images) ||
+        !map_labels(folder + "/train-labels-idx1-ubyte", dataset.files[1], dataset.training_labels) ||
+        !load_idx_test_set(folder, dataset))
+    {
+        return false;
+    }
+
+    if (dataset.training_images.size() != dataset.training_labels.size())
+    {
+        std::cout << "Error: image and label counts do not match" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool load_idx_test_set(const std::string &folder, IDX_DATASET &dataset)
+{
+    if (!dataset.files[0].data)
+    {
+        IMAGE_TENSOR images = {nullptr, 0, 0, 0, 0};
+        LABEL_VIEW labels = {nullptr, 0};
+        dataset.training_images = images;
+        dataset.training_labels = labels;
+    }
+
+    if (!map_images(folder + "/t10k-images-idx3-ubyte", dataset.files[2], dataset.test_images) ||
+        !map_labels(folder + "/t10k-labels-idx1-ubyte", dataset.files[3], dataset.test_labels))
+    {
+        return false;
+    }
+
+    if (dataset.test_images.size() != dataset.test_labels.size())
+    {
+        std::cout << "Error: image and label counts do not match" << std::endl;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,344 @@
+#include "../include/idx_stream.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * read exactly bytes from fd at offset, retrying short reads
+ */
+static bool read_exact(int fd, uint8_t *buffer, size_t bytes, uint64_t offset)
+{
+    while (bytes > 0)
+    {
+        ssize_t result = pread(fd, buffer, bytes, (off_t)offset);
+        if (result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (result <= 0)
+        {
+            return false;
+        }
+        buffer += result;
+        bytes -= result;
+        offset += result;
+    }
+    return true;
+}
+
+/*
+ * decode a big-endian 32-bit header field
+ */
+static uint64_t decode_header(const uint8_t *bytes)
+{
+    return ((uint64_t)bytes[0] << 24) | ((uint64_t)bytes[1] << 16) | ((uint64_t)bytes[2] << 8) | (uint64_t)bytes[3];
+}
+
+/*
+ * open an IDX file and read its header of header_fields 32-bit values
+ * the file is checked to hold header[1] items of item_bytes times the remaining dimensions
+ */
+static int open_idx(const std::string &path, uint64_t magic, uint64_t *header, int header_fields,
+                    uint64_t item_bytes)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cout << "Error opening file " << path << std::endl;
+        return -1;
+    }
+
+    uint8_t bytes[16];
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !read_exact(fd, bytes, header_fields * 4, 0))
+    {
+        std::cout << "Error reading file " << path << std::endl;
+        close(fd);
+        return -1;
+    }
+
+    for (int i = 0; i < header_fields; i++)
+    {
+        header[i] = decode_header(bytes + i * 4);
+    }
+    if (header[0] != magic)
+    {
+        std::cout << "Invalid magic number, probably not a MNIST file" << std::endl;
+        close(fd);
+        return -1;
+    }
+
+    // images hold rows x columns bytes per item, 64-bit arithmetic since the product
+    // overflows 32 bits for large corpora
+    for (int i = 2; i < header_fields; i++)
+    {
+        item_bytes *= header[i];
+    }
+    if ((uint64_t)info.st_size < header_fields * 4 + header[1] * item_bytes)
+    {
+        std::cout << "The file is not large enough to hold all the data, probably corrupted" << std::endl;
+        close(fd);
+        return -1;
+    }
+
+    // the chunks are read front to back, let the kernel read ahead
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    return fd;
+}
+
+IDX_STREAM::IDX_STREAM()
+    : images_fd(-1), labels_fd(-1), count(0), rows(0), columns(0), chunk_samples(0), num_chunks(0), largest_label(-1),
+      shuffle(false),
+      sparse_inputs(false), read_chunk(0), next_chunk(0), position(0), holding(false), stopping(false), read_failed(false)
+{
+    this->ready[0] = this->ready[1] = false;
+    this->buffer_samples[0] = this->buffer_samples[1] = 0;
+}
+
+IDX_STREAM::~IDX_STREAM()
+{
+    if (this->prefetcher.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->condition.notify_all();
+        this->prefetcher.join();
+    }
+    this->close_files();
+}
+
+void IDX_STREAM::close_files()
+{
+    if (this->images_fd >= 0)
+    {
+        close(this->images_fd);
+        this->images_fd = -1;
+    }
+    if (this->labels_fd >= 0)
+    {
+        close(this->labels_fd);
+        this->labels_fd = -1;
+    }
+}
+
+bool IDX_STREAM::open(const std::string &images_path, const std::string &labels_path, size_t chunk_samples,
+                      bool shuffle, unsigned int seed, bool sparse_inputs)
+{
+    uint64_t image_header[4];
+    uint64_t label_header[2];
+
+    this->images_fd = open_idx(images_path, IDX_IMAGES_MAGIC, image_header, 4, 1);
+    if (this->images_fd < 0)
+    {
+        return false;
+    }
+    this->count = image_header[1];
+    this->rows = image_header[2];
+    this->columns = image_header[3];
+
+    this->labels_fd = open_idx(labels_path, IDX_LABELS_MAGIC, label_header, 2, 1);
+    if (this->labels_fd < 0)
+    {
+        this->close_files();
+        return false;
+    }
+    if (label_header[1] != this->count)
+    {
+        std::cout << "Error: image and label counts do not match" << std::endl;
+        this->close_files();
+        return false;
+    }
+
+    this->images_path = images_path;
+    this->labels_path = labels_path;
+    this->chunk_samples = std::max((size_t)1, chunk_samples);
+    this->num_chunks = (this->count + this->chunk_samples - 1) / this->chunk_samples;
+    this->shuffle = shuffle;
+    this->generator.seed(seed);
+    this->sparse_inputs = sparse_inputs && this->pixels() <= SPARSE_MAX_PIXELS;
+
+    // file order until the first shuffle
+    this->chunk_order.resize(this->num_chunks);
+    for (size_t c = 0; c < this->num_chunks; c++)
+    {
+        this->chunk_order[c] = c;
+    }
+
+    size_t buffered = std::min(this->chunk_samples, this->count);
+    for (int b = 0; b < 2; b++)
+    {
+        this->image_buffers[b].resize(buffered * this->pixels());
+        this->label_buffers[b].resize(buffered);
+        this->order_buffers[b].resize(buffered);
+        if (this->sparse_inputs)
+        {
+            this->sparse_buffers[b].reserve(buffered, this->pixels());
+        }
+    }
+
+    if (!this->scan_labels())
+    {
+        this->close_files();
+        return false;
+    }
+
+    this->prefetcher = std::thread(&IDX_STREAM::prefetch_loop, this);
+    return true;
+}
+
+/*
+ * find the largest label, one byte per sample read through the first label buffer
+ * so the caller can check the classes before training on any chunk
+ */
+bool IDX_STREAM::scan_labels()
+{
+    std::vector<uint8_t> &buffer = this->label_buffers[0];
+    this->largest_label = -1;
+    for (uint64_t first = 0; first < this->count; first += buffer.size())
+    {
+        size_t samples = std::min((uint64_t)buffer.size(), this->count - first);
+        if (!read_exact(this->labels_fd, buffer.data(), samples, 8 + first))
+        {
+            std::cout << "Error reading file " << this->labels_path << std::endl;
+            return false;
+        }
+        this->largest_label = std::max(this->largest_label, (int)*std::max_element(buffer.begin(), buffer.begin() + samples));
+    }
+    return true;
+}
+
+bool IDX_STREAM::read_chunk_into(size_t chunk, int buffer)
+{
+    uint64_t first = (uint64_t)chunk * this->chunk_samples;
+    size_t samples = std::min((uint64_t)this->chunk_samples, this->count - first);
+    this->buffer_samples[buffer] = samples;
+
+    if (!read_exact(this->images_fd, this->image_buffers[buffer].data(), samples * this->pixels(),
+                    16 + first * this->pixels()))
+    {
+        std::cout << "Error reading file " << this->images_path << std::endl;
+        return false;
+    }
+    if (!read_exact(this->labels_fd, this->label_buffers[buffer].data(), samples, 8 + first))
+    {
+        std::cout << "Error reading file " << this->labels_path << std::endl;
+        return false;
+    }
+
+    // the lists are indexed like the pixels, so the order below applies to both
+    if (this->sparse_inputs)
+    {
+        IMAGE_TENSOR images = {this->image_buffers[buffer].data(), samples, this->rows, this->columns, this->pixels()};
+        this->sparse_buffers[buffer].build(images);
+    }
+
+    // the samples are visited through the order, the pixels stay where they were read
+    std::vector<uint32_t> &order = this->order_buffers[buffer];
+    for (size_t i = 0; i < samples; i++)
+    {
+        order[i] = i;
+    }
+    if (this->shuffle)
+    {
+        std::shuffle(order.begin(), order.begin() + samples, this->generator);
+    }
+    return true;
+}
+
+void IDX_STREAM::prefetch_loop()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    while (true)
+    {
+        // wait for a chunk to read and a free buffer for it
+        // a buffer stays ready while its chunk waits for the caller or is in use
+        this->condition.wait(lock, [&]
+                             {
+            if (this->stopping)
+            {
+                return true;
+            }
+            return !this->read_failed && this->read_chunk < this->num_chunks && !this->ready[this->read_chunk % 2]; });
+
+        if (this->stopping)
+        {
+            return;
+        }
+
+        // read without holding the lock so the caller can keep training on the other buffer
+        size_t position = this->read_chunk;
+        int buffer = position % 2;
+        lock.unlock();
+
+        // a new epoch visits the chunks in a new order
+        if (position == 0 && this->shuffle)
+        {
+            std::shuffle(this->chunk_order.begin(), this->chunk_order.end(), this->generator);
+        }
+        bool success = this->read_chunk_into(this->chunk_order[position], buffer);
+        lock.lock();
+
+        if (success)
+        {
+            this->ready[buffer] = true;
+            this->read_chunk++;
+        }
+        else
+        {
+            this->read_failed = true;
+        }
+        this->condition.notify_all();
+    }
+}
+
+bool IDX_STREAM::next(IDX_CHUNK &chunk)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    // give the previous chunk back to the prefetch thread
+    if (this->holding)
+    {
+        this->ready[(this->next_chunk - 1) % 2] = false;
+        this->holding = false;
+        this->condition.notify_all();
+    }
+
+    if (this->next_chunk < this->num_chunks)
+    {
+        int buffer = this->next_chunk % 2;
+        this->condition.wait(lock, [&]
+                             { return this->ready[buffer] || this->read_failed; });
+
+        if (this->ready[buffer])
+        {
+            size_t samples = this->buffer_samples[buffer];
+
+            IMAGE_TENSOR images = {this->image_buffers[buffer].data(), samples, this->rows, this->columns, this->pixels()};
+            LABEL_VIEW labels = {this->label_buffers[buffer].data(), samples};
+            DATASET_VIEW view = {images, labels, this->order_buffers[buffer].data(), 0, samples};
+            chunk.samples = view;
+            chunk.first = this->position;
+            chunk.sparse = this->sparse_inputs ? &this->sparse_buffers[buffer] : nullptr;
+
+            this->holding = true;
+            this->next_chunk++;
+            this->position += samples;
+            return true;
+        }
+    }
+
+    // end of the epoch, rewind so the prefetch thread starts on the next one right away
+    // every chunk has been read and given back at this point, so the prefetch thread is idle
+    this->next_chunk = 0;
+    this->read_chunk = 0;
+    this->position = 0;
+    this->ready[0] = this->ready[1] = false;
+    this->condition.notify_all();
+    return false;
+}
@@ -0,0 +1,92 @@
+#include "../include/inference_engine.hpp"
+#include "../include/gemm.hpp"
+#include "../include/kernels.hpp"
+#include <cmath>
+#include <cstring>
+
+InferenceEngine::InferenceEngine(const LAYER &hidden_layer, const LAYER &output_layer)
+    : hidden_weights(hidden_layer.weights),
+      hidden_biases(1, hidden_layer.biases.size()),
+      output_weights(output_layer.weights),
+      output_biases(1, output_layer.biases.size()),
+      hidden(INFERENCE_BLOCK, hidden_layer.weights.rows),
+      logits(1, output_layer.weights.rows)
+{
+    std::memcpy(this->hidden_biases.data, hidden_layer.biases.data(), hidden_layer.biases.size() * sizeof(float));
+    std::memcpy(this->output_biases.data, output_layer.biases.data(), output_layer.biases.size() * sizeof(float));
+}
+
+void InferenceEngine::predict(const float *images, size_t n, int *labels, float *probs)
+{
+    size_t inputs = this->num_inputs();
+    size_t classes = this->num_classes();
+
+    for (size_t start = 0; start < n; start += INFERENCE_BLOCK)
+    {
+        size_t count = n - start < INFERENCE_BLOCK ? n - start : INFERENCE_BLOCK;
+        this->predict_block(images + start * inputs, count,
+                            labels ? labels + start : nullptr,
+                            probs ? probs + start * classes : nullptr);
+    }
+}
+
+void InferenceEngine::predict_block(const float *images, size_t count, int *labels, float *probs)
+{
+    size_t inputs = this->num_inputs();
+    size_t neurons = this->hidden_weights.rows;
+    size_t classes = this->num_classes();
+
+    // the caller's images are read in place as a count x inputs matrix
+    MATRIX_VIEW input_view = {const_cast<float *>(images), count, inputs, inputs};
+    MATRIX_VIEW hidden_view = this->hidden.view();
+    hidden_view.rows = count;
+
+    // start every row from the biases so the product accumulates straight onto them
+    for (size_t r = 0; r < count; r++)
+    {
+        std::memcpy(hidden_view.row(r), this->hidden_biases.data, neurons * sizeof(float));
+    }
+    gemm_nt(1.0f, input_view, this->hidden_weights.view(), 1.0f, hidden_view);
+
+    // output layer, fused per row: ReLU, logits, softmax and argmax while the row is in L1
+    float *logit = this->logits.data;
+    for (size_t r = 0; r < count; r++)
+    {
+        float *activation = hidden_view.row(r);
+        for (size_t i = 0; i < neurons; i++)
+        {
+            activation[i] = activation[i] > 0.0f ? activation[i] : 0.0f;
+        }
+
+        int best = 0;
+        for (size_t c = 0; c < classes; c++)
+        {
+            logit[c] = dot(activation, this->output_weights.row(c), neurons) + this->output_biases.data[c];
+            if (logit[c] > logit[best])
+            {
+                best = c;
+            }
+        }
+
+        if (labels)
+        {
+            labels[r] = best;
+        }
+
+        if (probs)
+        {
+            // softmax, shifted by the largest logit for numerical stability
+            float *row = probs + r * classes;
+            float sum_exp = 0.0f;
+            for (size_t c = 0; c < classes; c++)
+            {
+                row[c] = std::exp(logit[c] - logit[best]);
+                sum_exp += row[c];
+            }
+            for (size_t c = 0; c < classes; c++)
+            {
+                row[c] /= sum_exp;
+            }
+        }
+    }
+}
@@ -0,0 +1,186 @@
+#include "../include/kernels.hpp"
+#include "../include/bf16.hpp"
+
+static float generic_dot(const float *a, const float *b, size_t n)
+{
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; i++)
+    {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+static void generic_axpy(float alpha, const float *x, float *y, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        y[i] += alpha * x[i];
+    }
+}
+
+static float generic_dot_u8(const float *a, const uint8_t *x, size_t n)
+{
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; i++)
+    {
+        sum += a[i] * x[i];
+    }
+    return sum;
+}
+
+static void generic_axpy_u8(float alpha, const uint8_t *x, float *y, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        y[i] += alpha * x[i];
+    }
+}
+
+static void generic_dot4_u8(const float *a, size_t stride, const uint8_t *x, size_t n, float *sums)
+{
+    for (int r = 0; r < DOT_ROWS; r++)
+    {
+        sums[r] = generic_dot_u8(a + r * stride, x, n);
+    }
+}
+
+static void generic_sum_columns_u8(const float *columns, size_t stride, const uint16_t *indices, const uint8_t *values,
+                                   size_t count, float *y, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        y[i] = 0.0f;
+    }
+    for (size_t k = 0; k < count; k++)
+    {
+        const float *column = columns + indices[k] * stride;
+        float value = values[k];
+        for (size_t i = 0; i < n; i++)
+        {
+            y[i] += value * column[i];
+        }
+    }
+}
+
+static void generic_update_columns_u8(float alpha, const float *x, size_t n, const uint16_t *indices,
+                                      const uint8_t *values, size_t count, float *columns, size_t stride)
+{
+    for (size_t k = 0; k < count; k++)
+    {
+        float *column = columns + indices[k] * stride;
+        float scale = alpha * values[k];
+        for (size_t i = 0; i < n; i++)
+        {
+            column[i] += scale * x[i];
+        }
+    }
+}
+
+static int32_t generic_dot_s8(const uint8_t *x, const int8_t *w, size_t n)
+{
+    int32_t sum = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        sum += x[i] * w[i];
+    }
+    return sum;
+}
+
+static float generic_dot_bf16(const uint16_t *a, const uint16_t *b, size_t n)
+{
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; i++)
+    {
+        sum += bf16_to_float(a[i]) * bf16_to_float(b[i]);
+    }
+    return sum;
+}
+
+static void generic_axpy_u8_bf16(float alpha, const uint8_t *x, float *y, uint16_t *y_bf16, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        y[i] += alpha * x[i];
+        y_bf16[i] = float_to_bf16(y[i]);
+    }
+}
+
+static void generic_gemm_kernel(size_t k, float alpha, const float *a_panel, const float *b_panel,
+                                float *c, size_t ldc, size_t mr, size_t nr)
+{
+    float acc[GEMM_MR][GEMM_NR] = {};
+
+    for (size_t p = 0; p < k; p++)
+    {
+        const float *a = a_panel + p * GEMM_MR;
+        const float *b = b_panel + p * GEMM_NR;
+        for (size_t i = 0; i < GEMM_MR; i++)
+        {
+            for (size_t j = 0; j < GEMM_NR; j++)
+            {
+                acc[i][j] += a[i] * b[j];
+            }
+        }
+    }
+
+    for (size_t i = 0; i < mr; i++)
+    {
+        for (size_t j = 0; j < nr; j++)
+        {
+            c[i * ldc + j] += alpha * acc[i][j];
+        }
+    }
+}
+
+static double generic_peak_probe(size_t iterations)
+{
+    // eight independent chains, enough to keep a scalar FMA/add pipe busy
+    float acc[8] = {0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f};
+    const float scale = 0.999999f;
+    const float offset = 1e-7f;
+
+    for (size_t it = 0; it < iterations; it++)
+    {
+        for (int i = 0; i < 8; i++)
+        {
+            acc[i] = acc[i] * scale + offset;
+        }
+    }
+
+    // keep the result alive so the loop is not removed
+    volatile float sink = acc[0] + acc[1] + acc[2] + acc[3] + acc[4] + acc[5] + acc[6] + acc[7];
+    (void)sink;
+    return 2.0 * 8 * iterations;
+}
+
+const KERNELS generic_kernels = {"generic", generic_dot, generic_axpy, generic_dot_u8, generic_axpy_u8, generic_dot4_u8, generic_sum_columns_u8, generic_update_columns_u8, generic_dot_s8, generic_dot_bf16, generic_axpy_u8_bf16, generic_gemm_kernel, generic_peak_probe};
+
+const KERNELS *select_kernels()
+{
+#ifdef KERNELS_X86
+    // cpuid based feature checks (including OS support for the wider registers)
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl"))
+    {
+        if (__builtin_cpu_supports("avx512vnni"))
+        {
+            return __builtin_cpu_supports("avx512bf16") ? &avx512_bf16_kernels : &avx512_vnni_kernels;
+        }
+        return &avx512_kernels;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        return &avx2_kernels;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        return &sse2_kernels;
+    }
+#endif
+    return &generic_kernels;
+}
+
+// selected during static initialization, before main runs
+const KERNELS *kernels = select_kernels();
@@ -0,0 +1,441 @@
+#include "../include/kernels.hpp"
+#include "../include/bf16.hpp"
+
+// compiled with -mavx2 -mfma, only called when cpuid reports support
+#ifdef KERNELS_X86
+#include <immintrin.h>
+
+static float avx2_dot(const float *a, const float *b, size_t n)
+{
+    // four independent accumulators hide the FMA latency
+    __m256 sum0 = _mm256_setzero_ps();
+    __m256 sum1 = _mm256_setzero_ps();
+    __m256 sum2 = _mm256_setzero_ps();
+    __m256 sum3 = _mm256_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), sum0);
+        sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), sum1);
+        sum2 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 16), _mm256_loadu_ps(b + i + 16), sum2);
+        sum3 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 24), _mm256_loadu_ps(b + i + 24), sum3);
+    }
+    for (; i + 8 <= n; i += 8)
+    {
+        sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), sum0);
+    }
+
+    // horizontal sum of the accumulators
+    __m256 sum = _mm256_add_ps(_mm256_add_ps(sum0, sum1), _mm256_add_ps(sum2, sum3));
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    float result = _mm_cvtss_f32(half);
+
+    for (; i < n; i++)
+    {
+        result += a[i] * b[i];
+    }
+    return result;
+}
+
+static void avx2_axpy(float alpha, const float *x, float *y, size_t n)
+{
+    __m256 scale = _mm256_set1_ps(alpha);
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        _mm256_storeu_ps(y + i, _mm256_fmadd_ps(scale, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+        _mm256_storeu_ps(y + i + 8, _mm256_fmadd_ps(scale, _mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(y + i + 8)));
+    }
+    for (; i + 8 <= n; i += 8)
+    {
+        _mm256_storeu_ps(y + i, _mm256_fmadd_ps(scale, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+    }
+    for (; i < n; i++)
+    {
+        y[i] += alpha * x[i];
+    }
+}
+
+/*
+ * widen 8 pixels to floats
+ */
+static inline __m256 avx2_load_pixels(const uint8_t *x)
+{
+    return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(x))));
+}
+
+static float avx2_dot_u8(const float *a, const uint8_t *x, size_t n)
+{
+    __m256 sum0 = _mm256_setzero_ps();
+    __m256 sum1 = _mm256_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), avx2_load_pixels(x + i), sum0);
+        sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), avx2_load_pixels(x + i + 8), sum1);
+    }
+    for (; i + 8 <= n; i += 8)
+    {
+        sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), avx2_load_pixels(x + i), sum0);
+    }
+
+    __m256 sum = _mm256_add_ps(sum0, sum1);
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    float result = _mm_cvtss_f32(half);
+
+    for (; i < n; i++)
+    {
+        result += a[i] * x[i];
+    }
+    return result;
+}
+
+static void avx2_axpy_u8(float alpha, const uint8_t *x, float *y, size_t n)
+{
+    __m256 scale = _mm256_set1_ps(alpha);
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        _mm256_storeu_ps(y + i, _mm256_fmadd_ps(scale, avx2_load_pixels(x + i), _mm256_loadu_ps(y + i)));
+    }
+    for (; i < n; i++)
+    {
+        y[i] += alpha * x[i];
+    }
+}
+
+/*
+ * horizontal sum of 8 float lanes
+ */
+static inline float avx2_sum_ps(__m256 sum)
+{
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    return _mm_cvtss_f32(half);
+}
+
+static void avx2_dot4_u8(const float *a, size_t stride, const uint8_t *x, size_t n, float *sums)
+{
+    const float *a0 = a;
+    const float *a1 = a + stride;
+    const float *a2 = a + 2 * stride;
+    const float *a3 = a + 3 * stride;
+    __m256 sum0 = _mm256_setzero_ps();
+    __m256 sum1 = _mm256_setzero_ps();
+    __m256 sum2 = _mm256_setzero_ps();
+    __m256 sum3 = _mm256_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 pixels = avx2_load_pixels(x + i);
+        sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a0 + i), pixels, sum0);
+        sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(a1 + i), pixels, sum1);
+        sum2 = _mm256_fmadd_ps(_mm256_loadu_ps(a2 + i), pixels, sum2);
+        sum3 = _mm256_fmadd_ps(_mm256_loadu_ps(a3 + i), pixels, sum3);
+    }
+
+    sums[0] = avx2_sum_ps(sum0);
+    sums[1] = avx2_sum_ps(sum1);
+    sums[2] = avx2_sum_ps(sum2);
+    sums[3] = avx2_sum_ps(sum3);
+    for (; i < n; i++)
+    {
+        sums[0] += a0[i] * x[i];
+        sums[1] += a1[i] * x[i];
+        sums[2] += a2[i] * x[i];
+        sums[3] += a3[i] * x[i];
+    }
+}
+
+static void avx2_sum_columns_u8(const float *columns, size_t stride, const uint16_t *indices, const uint8_t *values,
+                                size_t count, float *y, size_t n)
+{
+    // a block of 64 outputs stays in registers while the columns stream past
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64)
+    {
+        __m256 sum0 = _mm256_setzero_ps();
+        __m256 sum1 = _mm256_setzero_ps();
+        __m256 sum2 = _mm256_setzero_ps();
+        __m256 sum3 = _mm256_setzero_ps();
+        __m256 sum4 = _mm256_setzero_ps();
+        __m256 sum5 = _mm256_setzero_ps();
+        __m256 sum6 = _mm256_setzero_ps();
+        __m256 sum7 = _mm256_setzero_ps();
+        for (size_t k = 0; k < count; k++)
+        {
+            const float *column = columns + indices[k] * stride + i;
+            __m256 value = _mm256_set1_ps((float)values[k]);
+            sum0 = _mm256_fmadd_ps(value, _mm256_loadu_ps(column), sum0);
+            sum1 = _mm256_fmadd_ps(value, _mm256_loadu_ps(column + 8), sum1);
+            sum2 = _mm256_fmadd_ps(value, _mm256_loadu_ps(column + 16), sum2);
+            sum3 = _mm256_fmadd_ps(value, _mm256_loadu_ps(column + 24), sum3);
+            sum4 = _mm256_fmadd_ps(value, _mm256_loadu_ps(column + 32), sum4);
+            sum5 = _mm256_fmadd_ps(value, _mm256_loadu_ps(column + 40), sum5);
+            sum6 = _mm256_fmadd_ps(value, _mm256_loadu_ps(column + 48), sum6);
+            sum7 = _mm256_fmadd_ps(value, _mm256_loadu_ps(column + 56), sum7);
+        }
+        _mm256_storeu_ps(y + i, sum0);
+        _mm256_storeu_ps(y + i + 8, sum1);
+        _mm256_storeu_ps(y + i + 16, sum2);
+        _mm256_storeu_ps(y + i + 24, sum3);
+        _mm256_storeu_ps(y + i + 32, sum4);
+        _mm256_storeu_ps(y + i + 40, sum5);
+        _mm256_storeu_ps(y + i + 48, sum6);
+        _mm256_storeu_ps(y + i + 56, sum7);
+    }
+
+    // the outputs past the last block are summed column by column
+    for (size_t j = i; j < n; j++)
+    {
+        y[j] = 0.0f;
+    }
+    for (size_t k = 0; k < count; k++)
+    {
+        const float *column = columns + indices[k] * stride;
+        float value = values[k];
+        for (size_t j = i; j < n; j++)
+        {
+            y[j] += value * column[j];
+        }
+    }
+}
+
+static void avx2_update_columns_u8(float alpha, const float *x, size_t n, const uint16_t *indices,
+                                   const uint8_t *values, size_t count, float *columns, size_t stride)
+{
+    // a block of 64 inputs stays in registers while the columns are updated
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64)
+    {
+        __m256 x0 = _mm256_loadu_ps(x + i);
+        __m256 x1 = _mm256_loadu_ps(x + i + 8);
+        __m256 x2 = _mm256_loadu_ps(x + i + 16);
+        __m256 x3 = _mm256_loadu_ps(x + i + 24);
+        __m256 x4 = _mm256_loadu_ps(x + i + 32);
+        __m256 x5 = _mm256_loadu_ps(x + i + 40);
+        __m256 x6 = _mm256_loadu_ps(x + i + 48);
+        __m256 x7 = _mm256_loadu_ps(x + i + 56);
+        for (size_t k = 0; k < count; k++)
+        {
+            float *column = columns + indices[k] * stride + i;
+            __m256 scale = _mm256_set1_ps(alpha * values[k]);
+            _mm256_storeu_ps(column, _mm256_fmadd_ps(scale, x0, _mm256_loadu_ps(column)));
+            _mm256_storeu_ps(column + 8, _mm256_fmadd_ps(scale, x1, _mm256_loadu_ps(column + 8)));
+            _mm256_storeu_ps(column + 16, _mm256_fmadd_ps(scale, x2, _mm256_loadu_ps(column + 16)));
+            _mm256_storeu_ps(column + 24, _mm256_fmadd_ps(scale, x3, _mm256_loadu_ps(column + 24)));
+            _mm256_storeu_ps(column + 32, _mm256_fmadd_ps(scale, x4, _mm256_loadu_ps(column + 32)));
+            _mm256_storeu_ps(column + 40, _mm256_fmadd_ps(scale, x5, _mm256_loadu_ps(column + 40)));
+            _mm256_storeu_ps(column + 48, _mm256_fmadd_ps(scale, x6, _mm256_loadu_ps(column + 48)));
+            _mm256_storeu_ps(column + 56, _mm256_fmadd_ps(scale, x7, _mm256_loadu_ps(column + 56)));
+        }
+    }
+
+    // the inputs past the last block are applied column by column
+    for (size_t k = 0; k < count; k++)
+    {
+        float *column = columns + indices[k] * stride;
+        float scale = alpha * values[k];
+        for (size_t j = i; j < n; j++)
+        {
+            column[j] += scale * x[j];
+        }
+    }
+}
+
+static int32_t avx2_dot_s8(const uint8_t *x, const int8_t *w, size_t n)
+{
+    __m256i sum0 = _mm256_setzero_si256();
+    __m256i sum1 = _mm256_setzero_si256();
+
+    // widen to 16 bits and use vpmaddwd, which is exact for 8-bit products
+    // where vpmaddubsw would saturate 255 * 127 pairs
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i x0 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(x + i)));
+        __m256i w0 = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(w + i)));
+        __m256i x1 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(x + i + 16)));
+        __m256i w1 = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(w + i + 16)));
+        sum0 = _mm256_add_epi32(sum0, _mm256_madd_epi16(x0, w0));
+        sum1 = _mm256_add_epi32(sum1, _mm256_madd_epi16(x1, w1));
+    }
+
+    int32_t lanes[8];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), _mm256_add_epi32(sum0, sum1));
+    int32_t result = 0;
+    for (int lane = 0; lane < 8; lane++)
+    {
+        result += lanes[lane];
+    }
+
+    for (; i < n; i++)
+    {
+        result += x[i] * w[i];
+    }
+    return result;
+}
+
+/*
+ * widen 8 bf16 values to floats
+ */
+static inline __m256 avx2_load_bf16(const uint16_t *w)
+{
+    __m256i words = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(w)));
+    return _mm256_castsi256_ps(_mm256_slli_epi32(words, 16));
+}
+
+/*
+ * round 8 floats to bf16 (ties to even) and store them
+ */
+static inline void avx2_store_bf16(uint16_t *y, __m256 values)
+{
+    __m256i bits = _mm256_castps_si256(values);
+    __m256i rounding = _mm256_add_epi32(_mm256_set1_epi32(0x7FFF),
+                                        _mm256_and_si256(_mm256_srli_epi32(bits, 16), _mm256_set1_epi32(1)));
+    bits = _mm256_srli_epi32(_mm256_add_epi32(bits, rounding), 16);
+    __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(bits), _mm256_extracti128_si256(bits, 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(y), packed);
+}
+
+static float avx2_dot_bf16(const uint16_t *a, const uint16_t *b, size_t n)
+{
+    __m256 sum0 = _mm256_setzero_ps();
+    __m256 sum1 = _mm256_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        sum0 = _mm256_fmadd_ps(avx2_load_bf16(a + i), avx2_load_bf16(b + i), sum0);
+        sum1 = _mm256_fmadd_ps(avx2_load_bf16(a + i + 8), avx2_load_bf16(b + i + 8), sum1);
+    }
+    for (; i + 8 <= n; i += 8)
+    {
+        sum0 = _mm256_fmadd_ps(avx2_load_bf16(a + i), avx2_load_bf16(b + i), sum0);
+    }
+
+    __m256 sum = _mm256_add_ps(sum0, sum1);
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    float result = _mm_cvtss_f32(half);
+
+    for (; i < n; i++)
+    {
+        result += bf16_to_float(a[i]) * bf16_to_float(b[i]);
+    }
+    return result;
+}
+
+static void avx2_axpy_u8_bf16(float alpha, const uint8_t *x, float *y, uint16_t *y_bf16, size_t n)
+{
+    __m256 scale = _mm256_set1_ps(alpha);
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 updated = _mm256_fmadd_ps(scale, avx2_load_pixels(x + i), _mm256_loadu_ps(y + i));
+        _mm256_storeu_ps(y + i, updated);
+        avx2_store_bf16(y_bf16 + i, updated);
+    }
+    for (; i < n; i++)
+    {
+        y[i] += alpha * x[i];
+        y_bf16[i] = float_to_bf16(y[i]);
+    }
+}
+
+static void avx2_gemm_kernel(size_t k, float alpha, const float *a_panel, const float *b_panel,
+                             float *c, size_t ldc, size_t mr, size_t nr)
+{
+    // 6x16 tile: 12 accumulators, 2 rows of b and one broadcast fit in 16 registers
+    __m256 acc[GEMM_MR][2];
+    #pragma GCC unroll 6
+    for (size_t i = 0; i < GEMM_MR; i++)
+    {
+        acc[i][0] = _mm256_setzero_ps();
+        acc[i][1] = _mm256_setzero_ps();
+    }
+
+    for (size_t p = 0; p < k; p++)
+    {
+        const float *a = a_panel + p * GEMM_MR;
+        __m256 b0 = _mm256_load_ps(b_panel + p * GEMM_NR);
+        __m256 b1 = _mm256_load_ps(b_panel + p * GEMM_NR + 8);
+    #pragma GCC unroll 6
+    for (size_t i = 0; i < GEMM_MR; i++)
+        {
+            __m256 ai = _mm256_broadcast_ss(a + i);
+            acc[i][0] = _mm256_fmadd_ps(ai, b0, acc[i][0]);
+            acc[i][1] = _mm256_fmadd_ps(ai, b1, acc[i][1]);
+        }
+    }
+
+    // scale and add the tile to c, element-wise at the matrix edges
+    __m256 scale = _mm256_set1_ps(alpha);
+    for (size_t i = 0; i < mr; i++)
+    {
+        float *c_row = c + i * ldc;
+        if (nr == GEMM_NR)
+        {
+            _mm256_storeu_ps(c_row, _mm256_fmadd_ps(scale, acc[i][0], _mm256_loadu_ps(c_row)));
+            _mm256_storeu_ps(c_row + 8, _mm256_fmadd_ps(scale, acc[i][1], _mm256_loadu_ps(c_row + 8)));
+        }
+        else
+        {
+            float tile[GEMM_NR];
+            _mm256_storeu_ps(tile, acc[i][0]);
+            _mm256_storeu_ps(tile + 8, acc[i][1]);
+            for (size_t j = 0; j < nr; j++)
+            {
+                c_row[j] += alpha * tile[j];
+            }
+        }
+    }
+}
+
+static double avx2_peak_probe(size_t iterations)
+{
+    // twelve independent FMA chains cover latency x throughput of two FMA ports
+    __m256 acc[12];
+    #pragma GCC unroll 12
+    for (int i = 0; i < 12; i++)
+    {
+        acc[i] = _mm256_set1_ps((float)i);
+    }
+    const __m256 scale = _mm256_set1_ps(0.999999f);
+    const __m256 offset = _mm256_set1_ps(1e-7f);
+
+    for (size_t it = 0; it < iterations; it++)
+    {
+    #pragma GCC unroll 12
+    for (int i = 0; i < 12; i++)
+        {
+            acc[i] = _mm256_fmadd_ps(acc[i], scale, offset);
+        }
+    }
+
+    __m256 sum = acc[0];
+    #pragma GCC unroll 12
+    for (int i = 1; i < 12; i++)
+    {
+        sum = _mm256_add_ps(sum, acc[i]);
+    }
+    volatile float sink = _mm_cvtss_f32(_mm256_castps256_ps128(sum));
+    (void)sink;
+    return 2.0 * 12 * 8 * iterations;
+}
+
+const KERNELS avx2_kernels = {"avx2+fma", avx2_dot, avx2_axpy, avx2_dot_u8, avx2_axpy_u8, avx2_dot4_u8, avx2_sum_columns_u8, avx2_update_columns_u8, avx2_dot_s8, avx2_dot_bf16, avx2_axpy_u8_bf16, avx2_gemm_kernel, avx2_peak_probe};
+
+#endif
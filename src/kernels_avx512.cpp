@@ -0,0 +1,519 @@
+#include "../include/kernels.hpp"
+#include "../include/bf16.hpp"
+
+// compiled with -mavx512f -mavx512bw -mavx512vl, only called when cpuid reports support
+#ifdef KERNELS_X86
+#include <immintrin.h>
+
+static float avx512_dot(const float *a, const float *b, size_t n)
+{
+    // two independent accumulators hide the FMA latency
+    __m512 sum0 = _mm512_setzero_ps();
+    __m512 sum1 = _mm512_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        sum0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), sum0);
+        sum1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), sum1);
+    }
+    for (; i + 16 <= n; i += 16)
+    {
+        sum0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), sum0);
+    }
+
+    // masked loads handle the tail without a scalar loop
+    if (i < n)
+    {
+        __mmask16 mask = (__mmask16)((1u << (n - i)) - 1);
+        sum1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i), sum1);
+    }
+
+    // horizontal sum through memory, the gcc 12 lane extract intrinsics
+    // trip -Wuninitialized and this runs once per dot product
+    float lanes[16];
+    _mm512_storeu_ps(lanes, _mm512_add_ps(sum0, sum1));
+    for (int width = 8; width > 0; width /= 2)
+    {
+        for (int lane = 0; lane < width; lane++)
+        {
+            lanes[lane] += lanes[lane + width];
+        }
+    }
+    return lanes[0];
+}
+
+static void avx512_axpy(float alpha, const float *x, float *y, size_t n)
+{
+    __m512 scale = _mm512_set1_ps(alpha);
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        _mm512_storeu_ps(y + i, _mm512_fmadd_ps(scale, _mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+    }
+    if (i < n)
+    {
+        __mmask16 mask = (__mmask16)((1u << (n - i)) - 1);
+        __m512 updated = _mm512_fmadd_ps(scale, _mm512_maskz_loadu_ps(mask, x + i), _mm512_maskz_loadu_ps(mask, y + i));
+        _mm512_mask_storeu_ps(y + i, mask, updated);
+    }
+}
+
+/*
+ * widen 16 pixels (or the first bits of mask) to floats
+ */
+static inline __m512 avx512_load_pixels(const uint8_t *x, __mmask16 mask)
+{
+    // the zero-masking forms avoid gcc 12 -Wmaybe-uninitialized false positives
+    return _mm512_maskz_cvtepi32_ps(mask, _mm512_maskz_cvtepu8_epi32(mask, _mm_maskz_loadu_epi8(mask, x)));
+}
+
+static float avx512_dot_u8(const float *a, const uint8_t *x, size_t n)
+{
+    __m512 sum0 = _mm512_setzero_ps();
+    __m512 sum1 = _mm512_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        sum0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), avx512_load_pixels(x + i, 0xFFFF), sum0);
+        sum1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), avx512_load_pixels(x + i + 16, 0xFFFF), sum1);
+    }
+    for (; i < n; i += 16)
+    {
+        __mmask16 mask = n - i >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << (n - i)) - 1);
+        sum0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + i), avx512_load_pixels(x + i, mask), sum0);
+    }
+
+    float lanes[16];
+    _mm512_storeu_ps(lanes, _mm512_add_ps(sum0, sum1));
+    for (int width = 8; width > 0; width /= 2)
+    {
+        for (int lane = 0; lane < width; lane++)
+        {
+            lanes[lane] += lanes[lane + width];
+        }
+    }
+    return lanes[0];
+}
+
+static void avx512_axpy_u8(float alpha, const uint8_t *x, float *y, size_t n)
+{
+    __m512 scale = _mm512_set1_ps(alpha);
+
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        __m512 x0 = avx512_load_pixels(x + i, 0xFFFF);
+        __m512 x1 = avx512_load_pixels(x + i + 16, 0xFFFF);
+        _mm512_storeu_ps(y + i, _mm512_fmadd_ps(scale, x0, _mm512_loadu_ps(y + i)));
+        _mm512_storeu_ps(y + i + 16, _mm512_fmadd_ps(scale, x1, _mm512_loadu_ps(y + i + 16)));
+    }
+    for (; i < n; i += 16)
+    {
+        __mmask16 mask = n - i >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << (n - i)) - 1);
+        __m512 updated = _mm512_fmadd_ps(scale, avx512_load_pixels(x + i, mask), _mm512_maskz_loadu_ps(mask, y + i));
+        _mm512_mask_storeu_ps(y + i, mask, updated);
+    }
+}
+
+/*
+ * horizontal sum of 16 float lanes through memory (the reduce intrinsics trip gcc 12 warnings)
+ */
+static inline float avx512_sum_ps(__m512 sum)
+{
+    float lanes[16];
+    _mm512_storeu_ps(lanes, sum);
+    for (int width = 8; width > 0; width /= 2)
+    {
+        for (int lane = 0; lane < width; lane++)
+        {
+            lanes[lane] += lanes[lane + width];
+        }
+    }
+    return lanes[0];
+}
+
+static void avx512_dot4_u8(const float *a, size_t stride, const uint8_t *x, size_t n, float *sums)
+{
+    const float *a0 = a;
+    const float *a1 = a + stride;
+    const float *a2 = a + 2 * stride;
+    const float *a3 = a + 3 * stride;
+    __m512 sum0 = _mm512_setzero_ps();
+    __m512 sum1 = _mm512_setzero_ps();
+    __m512 sum2 = _mm512_setzero_ps();
+    __m512 sum3 = _mm512_setzero_ps();
+
+    // one pixel conversion feeds every row, the independent accumulators hide the fma latency
+    for (size_t i = 0; i < n; i += 16)
+    {
+        __mmask16 mask = n - i >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << (n - i)) - 1);
+        __m512 pixels = avx512_load_pixels(x + i, mask);
+        sum0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a0 + i), pixels, sum0);
+        sum1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a1 + i), pixels, sum1);
+        sum2 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a2 + i), pixels, sum2);
+        sum3 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a3 + i), pixels, sum3);
+    }
+
+    sums[0] = avx512_sum_ps(sum0);
+    sums[1] = avx512_sum_ps(sum1);
+    sums[2] = avx512_sum_ps(sum2);
+    sums[3] = avx512_sum_ps(sum3);
+}
+
+/*
+ * lanes of the 16-float vector at i that are below n
+ */
+static inline __mmask16 avx512_tail_mask(size_t i, size_t n)
+{
+    return i >= n ? (__mmask16)0 : n - i >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << (n - i)) - 1);
+}
+
+static void avx512_sum_columns_u8(const float *columns, size_t stride, const uint16_t *indices, const uint8_t *values,
+                                  size_t count, float *y, size_t n)
+{
+    // a block of 128 outputs stays in registers while the columns stream past,
+    // the masks cut the last block at n
+    for (size_t i = 0; i < n; i += 128)
+    {
+        __mmask16 mask0 = avx512_tail_mask(i, n);
+        __mmask16 mask1 = avx512_tail_mask(i + 16, n);
+        __mmask16 mask2 = avx512_tail_mask(i + 32, n);
+        __mmask16 mask3 = avx512_tail_mask(i + 48, n);
+        __mmask16 mask4 = avx512_tail_mask(i + 64, n);
+        __mmask16 mask5 = avx512_tail_mask(i + 80, n);
+        __mmask16 mask6 = avx512_tail_mask(i + 96, n);
+        __mmask16 mask7 = avx512_tail_mask(i + 112, n);
+        __m512 sum0 = _mm512_setzero_ps();
+        __m512 sum1 = _mm512_setzero_ps();
+        __m512 sum2 = _mm512_setzero_ps();
+        __m512 sum3 = _mm512_setzero_ps();
+        __m512 sum4 = _mm512_setzero_ps();
+        __m512 sum5 = _mm512_setzero_ps();
+        __m512 sum6 = _mm512_setzero_ps();
+        __m512 sum7 = _mm512_setzero_ps();
+        for (size_t k = 0; k < count; k++)
+        {
+            const float *column = columns + indices[k] * stride + i;
+            __m512 value = _mm512_set1_ps((float)values[k]);
+            sum0 = _mm512_fmadd_ps(value, _mm512_maskz_loadu_ps(mask0, column), sum0);
+            sum1 = _mm512_fmadd_ps(value, _mm512_maskz_loadu_ps(mask1, column + 16), sum1);
+            sum2 = _mm512_fmadd_ps(value, _mm512_maskz_loadu_ps(mask2, column + 32), sum2);
+            sum3 = _mm512_fmadd_ps(value, _mm512_maskz_loadu_ps(mask3, column + 48), sum3);
+            sum4 = _mm512_fmadd_ps(value, _mm512_maskz_loadu_ps(mask4, column + 64), sum4);
+            sum5 = _mm512_fmadd_ps(value, _mm512_maskz_loadu_ps(mask5, column + 80), sum5);
+            sum6 = _mm512_fmadd_ps(value, _mm512_maskz_loadu_ps(mask6, column + 96), sum6);
+            sum7 = _mm512_fmadd_ps(value, _mm512_maskz_loadu_ps(mask7, column + 112), sum7);
+        }
+        _mm512_mask_storeu_ps(y + i, mask0, sum0);
+        _mm512_mask_storeu_ps(y + i + 16, mask1, sum1);
+        _mm512_mask_storeu_ps(y + i + 32, mask2, sum2);
+        _mm512_mask_storeu_ps(y + i + 48, mask3, sum3);
+        _mm512_mask_storeu_ps(y + i + 64, mask4, sum4);
+        _mm512_mask_storeu_ps(y + i + 80, mask5, sum5);
+        _mm512_mask_storeu_ps(y + i + 96, mask6, sum6);
+        _mm512_mask_storeu_ps(y + i + 112, mask7, sum7);
+    }
+}
+
+static void avx512_update_columns_u8(float alpha, const float *x, size_t n, const uint16_t *indices,
+                                     const uint8_t *values, size_t count, float *columns, size_t stride)
+{
+    // a block of 128 inputs stays in registers while the columns are updated
+    for (size_t i = 0; i < n; i += 128)
+    {
+        __mmask16 mask0 = avx512_tail_mask(i, n);
+        __mmask16 mask1 = avx512_tail_mask(i + 16, n);
+        __mmask16 mask2 = avx512_tail_mask(i + 32, n);
+        __mmask16 mask3 = avx512_tail_mask(i + 48, n);
+        __mmask16 mask4 = avx512_tail_mask(i + 64, n);
+        __mmask16 mask5 = avx512_tail_mask(i + 80, n);
+        __mmask16 mask6 = avx512_tail_mask(i + 96, n);
+        __mmask16 mask7 = avx512_tail_mask(i + 112, n);
+        __m512 x0 = _mm512_maskz_loadu_ps(mask0, x + i);
+        __m512 x1 = _mm512_maskz_loadu_ps(mask1, x + i + 16);
+        __m512 x2 = _mm512_maskz_loadu_ps(mask2, x + i + 32);
+        __m512 x3 = _mm512_maskz_loadu_ps(mask3, x + i + 48);
+        __m512 x4 = _mm512_maskz_loadu_ps(mask4, x + i + 64);
+        __m512 x5 = _mm512_maskz_loadu_ps(mask5, x + i + 80);
+        __m512 x6 = _mm512_maskz_loadu_ps(mask6, x + i + 96);
+        __m512 x7 = _mm512_maskz_loadu_ps(mask7, x + i + 112);
+        for (size_t k = 0; k < count; k++)
+        {
+            float *column = columns + indices[k] * stride + i;
+            __m512 scale = _mm512_set1_ps(alpha * values[k]);
+            _mm512_mask_storeu_ps(column, mask0, _mm512_fmadd_ps(scale, x0, _mm512_maskz_loadu_ps(mask0, column)));
+            _mm512_mask_storeu_ps(column + 16, mask1, _mm512_fmadd_ps(scale, x1, _mm512_maskz_loadu_ps(mask1, column + 16)));
+            _mm512_mask_storeu_ps(column + 32, mask2, _mm512_fmadd_ps(scale, x2, _mm512_maskz_loadu_ps(mask2, column + 32)));
+            _mm512_mask_storeu_ps(column + 48, mask3, _mm512_fmadd_ps(scale, x3, _mm512_maskz_loadu_ps(mask3, column + 48)));
+            _mm512_mask_storeu_ps(column + 64, mask4, _mm512_fmadd_ps(scale, x4, _mm512_maskz_loadu_ps(mask4, column + 64)));
+            _mm512_mask_storeu_ps(column + 80, mask5, _mm512_fmadd_ps(scale, x5, _mm512_maskz_loadu_ps(mask5, column + 80)));
+            _mm512_mask_storeu_ps(column + 96, mask6, _mm512_fmadd_ps(scale, x6, _mm512_maskz_loadu_ps(mask6, column + 96)));
+            _mm512_mask_storeu_ps(column + 112, mask7, _mm512_fmadd_ps(scale, x7, _mm512_maskz_loadu_ps(mask7, column + 112)));
+        }
+    }
+}
+
+/*
+ * horizontal sum of 16 int32 lanes through memory
+ */
+static inline int32_t avx512_sum_epi32(__m512i sum)
+{
+    int32_t lanes[16];
+    _mm512_storeu_si512(lanes, sum);
+    int32_t result = 0;
+    for (int lane = 0; lane < 16; lane++)
+    {
+        result += lanes[lane];
+    }
+    return result;
+}
+
+static int32_t avx512_dot_s8(const uint8_t *x, const int8_t *w, size_t n)
+{
+    __m512i sum = _mm512_setzero_si512();
+
+    // widen to 16 bits and use vpmaddwd, exact for 8-bit products
+    size_t i = 0;
+    for (; i < n; i += 32)
+    {
+        __mmask32 mask = n - i >= 32 ? (__mmask32)0xFFFFFFFF : (__mmask32)((1u << (n - i)) - 1);
+        __m512i pixels = _mm512_maskz_cvtepu8_epi16(mask, _mm256_maskz_loadu_epi8(mask, x + i));
+        __m512i weights = _mm512_maskz_cvtepi8_epi16(mask, _mm256_maskz_loadu_epi8(mask, w + i));
+        sum = _mm512_add_epi32(sum, _mm512_madd_epi16(pixels, weights));
+    }
+    return avx512_sum_epi32(sum);
+}
+
+/*
+ * VNNI version, vpdpbusd multiplies unsigned pixels by signed weights
+ * and accumulates groups of four products into int32 without intermediate saturation
+ * compiled for avx512vnni through the target attribute, only called when cpuid reports it
+ */
+__attribute__((target("avx512vnni"))) static int32_t avx512_vnni_dot_s8(const uint8_t *x, const int8_t *w, size_t n)
+{
+    __m512i sum0 = _mm512_setzero_si512();
+    __m512i sum1 = _mm512_setzero_si512();
+
+    size_t i = 0;
+    for (; i + 128 <= n; i += 128)
+    {
+        sum0 = _mm512_dpbusd_epi32(sum0, _mm512_loadu_si512(x + i), _mm512_loadu_si512(w + i));
+        sum1 = _mm512_dpbusd_epi32(sum1, _mm512_loadu_si512(x + i + 64), _mm512_loadu_si512(w + i + 64));
+    }
+    for (; i < n; i += 64)
+    {
+        __mmask64 mask = n - i >= 64 ? ~(__mmask64)0 : (((__mmask64)1 << (n - i)) - 1);
+        sum0 = _mm512_dpbusd_epi32(sum0, _mm512_maskz_loadu_epi8(mask, x + i), _mm512_maskz_loadu_epi8(mask, w + i));
+    }
+    return avx512_sum_epi32(_mm512_add_epi32(sum0, sum1));
+}
+
+/*
+ * widen 16 bf16 values (or the first bits of mask) to floats
+ */
+static inline __m512 avx512_load_bf16(const uint16_t *w, __mmask16 mask)
+{
+    __m512i words = _mm512_maskz_cvtepu16_epi32(mask, _mm256_maskz_loadu_epi16(mask, w));
+    return _mm512_castsi512_ps(_mm512_maskz_slli_epi32(mask, words, 16));
+}
+
+static float avx512_dot_bf16(const uint16_t *a, const uint16_t *b, size_t n)
+{
+    __m512 sum0 = _mm512_setzero_ps();
+    __m512 sum1 = _mm512_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        sum0 = _mm512_fmadd_ps(avx512_load_bf16(a + i, 0xFFFF), avx512_load_bf16(b + i, 0xFFFF), sum0);
+        sum1 = _mm512_fmadd_ps(avx512_load_bf16(a + i + 16, 0xFFFF), avx512_load_bf16(b + i + 16, 0xFFFF), sum1);
+    }
+    for (; i < n; i += 16)
+    {
+        __mmask16 mask = n - i >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << (n - i)) - 1);
+        sum0 = _mm512_fmadd_ps(avx512_load_bf16(a + i, mask), avx512_load_bf16(b + i, mask), sum0);
+    }
+
+    float lanes[16];
+    _mm512_storeu_ps(lanes, _mm512_add_ps(sum0, sum1));
+    for (int width = 8; width > 0; width /= 2)
+    {
+        for (int lane = 0; lane < width; lane++)
+        {
+            lanes[lane] += lanes[lane + width];
+        }
+    }
+    return lanes[0];
+}
+
+/*
+ * round 16 floats to bf16 (ties to even), zero-masking forms for gcc 12 again
+ */
+static inline __m256i avx512_round_bf16(__m512 values, __mmask16 mask)
+{
+    __m512i bits = _mm512_castps_si512(values);
+    __m512i odd = _mm512_and_si512(_mm512_maskz_srli_epi32(mask, bits, 16), _mm512_set1_epi32(1));
+    bits = _mm512_add_epi32(bits, _mm512_add_epi32(_mm512_set1_epi32(0x7FFF), odd));
+    return _mm512_maskz_cvtepi32_epi16(mask, _mm512_maskz_srli_epi32(mask, bits, 16));
+}
+
+static void avx512_axpy_u8_bf16(float alpha, const uint8_t *x, float *y, uint16_t *y_bf16, size_t n)
+{
+    const __m512 scale = _mm512_set1_ps(alpha);
+
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        __m512 y0 = _mm512_fmadd_ps(scale, avx512_load_pixels(x + i, 0xFFFF), _mm512_loadu_ps(y + i));
+        __m512 y1 = _mm512_fmadd_ps(scale, avx512_load_pixels(x + i + 16, 0xFFFF), _mm512_loadu_ps(y + i + 16));
+        _mm512_storeu_ps(y + i, y0);
+        _mm512_storeu_ps(y + i + 16, y1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(y_bf16 + i), avx512_round_bf16(y0, 0xFFFF));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(y_bf16 + i + 16), avx512_round_bf16(y1, 0xFFFF));
+    }
+    for (; i < n; i += 16)
+    {
+        __mmask16 mask = n - i >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << (n - i)) - 1);
+        __m512 updated = _mm512_fmadd_ps(scale, avx512_load_pixels(x + i, mask), _mm512_maskz_loadu_ps(mask, y + i));
+        _mm512_mask_storeu_ps(y + i, mask, updated);
+        _mm256_mask_storeu_epi16(y_bf16 + i, mask, avx512_round_bf16(updated, mask));
+    }
+}
+
+/*
+ * AVX512-BF16 versions, vdpbf16ps multiplies pairs of bf16 values and accumulates them in fp32
+ * compiled for avx512bf16 through the target attribute, only called when cpuid reports it
+ */
+__attribute__((target("avx512bf16"))) static float avx512_bf16_dot_bf16(const uint16_t *a, const uint16_t *b, size_t n)
+{
+    __m512 sum0 = _mm512_setzero_ps();
+    __m512 sum1 = _mm512_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64)
+    {
+        sum0 = _mm512_dpbf16_ps(sum0, (__m512bh)_mm512_loadu_si512(a + i), (__m512bh)_mm512_loadu_si512(b + i));
+        sum1 = _mm512_dpbf16_ps(sum1, (__m512bh)_mm512_loadu_si512(a + i + 32), (__m512bh)_mm512_loadu_si512(b + i + 32));
+    }
+    for (; i < n; i += 32)
+    {
+        __mmask32 mask = n - i >= 32 ? (__mmask32)0xFFFFFFFF : (__mmask32)((1u << (n - i)) - 1);
+        sum0 = _mm512_dpbf16_ps(sum0, (__m512bh)_mm512_maskz_loadu_epi16(mask, a + i),
+                                (__m512bh)_mm512_maskz_loadu_epi16(mask, b + i));
+    }
+
+    float lanes[16];
+    _mm512_storeu_ps(lanes, _mm512_add_ps(sum0, sum1));
+    for (int width = 8; width > 0; width /= 2)
+    {
+        for (int lane = 0; lane < width; lane++)
+        {
+            lanes[lane] += lanes[lane + width];
+        }
+    }
+    return lanes[0];
+}
+
+__attribute__((target("avx512bf16"))) static void avx512_bf16_axpy_u8_bf16(float alpha, const uint8_t *x, float *y,
+                                                                           uint16_t *y_bf16, size_t n)
+{
+    const __m512 scale = _mm512_set1_ps(alpha);
+
+    // vcvtne2ps2bf16 rounds two vectors into one store
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        __m512 y0 = _mm512_fmadd_ps(scale, avx512_load_pixels(x + i, 0xFFFF), _mm512_loadu_ps(y + i));
+        __m512 y1 = _mm512_fmadd_ps(scale, avx512_load_pixels(x + i + 16, 0xFFFF), _mm512_loadu_ps(y + i + 16));
+        _mm512_storeu_ps(y + i, y0);
+        _mm512_storeu_ps(y + i + 16, y1);
+        _mm512_storeu_si512(y_bf16 + i, (__m512i)_mm512_cvtne2ps_pbh(y1, y0));
+    }
+    for (; i < n; i += 16)
+    {
+        __mmask16 mask = n - i >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << (n - i)) - 1);
+        __m512 updated = _mm512_fmadd_ps(scale, avx512_load_pixels(x + i, mask), _mm512_maskz_loadu_ps(mask, y + i));
+        _mm512_mask_storeu_ps(y + i, mask, updated);
+        _mm256_mask_storeu_epi16(y_bf16 + i, mask, (__m256i)_mm512_cvtneps_pbh(updated));
+    }
+}
+
+static void avx512_gemm_kernel(size_t k, float alpha, const float *a_panel, const float *b_panel,
+                               float *c, size_t ldc, size_t mr, size_t nr)
+{
+    // 6x16 tile, one 512-bit accumulator per row
+    __m512 acc[GEMM_MR];
+    #pragma GCC unroll 6
+    for (size_t i = 0; i < GEMM_MR; i++)
+    {
+        acc[i] = _mm512_setzero_ps();
+    }
+
+    for (size_t p = 0; p < k; p++)
+    {
+        const float *a = a_panel + p * GEMM_MR;
+        __m512 b = _mm512_load_ps(b_panel + p * GEMM_NR);
+    #pragma GCC unroll 6
+    for (size_t i = 0; i < GEMM_MR; i++)
+        {
+            acc[i] = _mm512_fmadd_ps(_mm512_set1_ps(a[i]), b, acc[i]);
+        }
+    }
+
+    // scale and add the tile to c, masked at the matrix edges
+    __m512 scale = _mm512_set1_ps(alpha);
+    __mmask16 mask = (__mmask16)((1u << nr) - 1);
+    for (size_t i = 0; i < mr; i++)
+    {
+        float *c_row = c + i * ldc;
+        __m512 updated = _mm512_fmadd_ps(scale, acc[i], _mm512_maskz_loadu_ps(mask, c_row));
+        _mm512_mask_storeu_ps(c_row, mask, updated);
+    }
+}
+
+static double avx512_peak_probe(size_t iterations)
+{
+    // twelve independent FMA chains cover latency x throughput of two FMA ports
+    __m512 acc[12];
+    #pragma GCC unroll 12
+    for (int i = 0; i < 12; i++)
+    {
+        acc[i] = _mm512_set1_ps((float)i);
+    }
+    const __m512 scale = _mm512_set1_ps(0.999999f);
+    const __m512 offset = _mm512_set1_ps(1e-7f);
+
+    for (size_t it = 0; it < iterations; it++)
+    {
+    #pragma GCC unroll 12
+    for (int i = 0; i < 12; i++)
+        {
+            acc[i] = _mm512_fmadd_ps(acc[i], scale, offset);
+        }
+    }
+
+    __m512 sum = acc[0];
+    #pragma GCC unroll 12
+    for (int i = 1; i < 12; i++)
+    {
+        sum = _mm512_add_ps(sum, acc[i]);
+    }
+    float lanes[16];
+    _mm512_storeu_ps(lanes, sum);
+    volatile float sink = lanes[0];
+    (void)sink;
+    return 2.0 * 12 * 16 * iterations;
+}
+
+const KERNELS avx512_kernels = {"avx512", avx512_dot, avx512_axpy, avx512_dot_u8, avx512_axpy_u8, avx512_dot4_u8, avx512_sum_columns_u8, avx512_update_columns_u8, avx512_dot_s8, avx512_dot_bf16, avx512_axpy_u8_bf16, avx512_gemm_kernel, avx512_peak_probe};
+
+// same table with the VNNI int8 dot product
+const KERNELS avx512_vnni_kernels = {"avx512+vnni", avx512_dot, avx512_axpy, avx512_dot_u8, avx512_axpy_u8, avx512_dot4_u8, avx512_sum_columns_u8, avx512_update_columns_u8, avx512_vnni_dot_s8, avx512_dot_bf16, avx512_axpy_u8_bf16, avx512_gemm_kernel, avx512_peak_probe};
+
+// VNNI and the BF16 dot products
+const KERNELS avx512_bf16_kernels = {"avx512+vnni+bf16", avx512_dot, avx512_axpy, avx512_dot_u8, avx512_axpy_u8, avx512_dot4_u8, avx512_sum_columns_u8, avx512_update_columns_u8, avx512_vnni_dot_s8, avx512_bf16_dot_bf16, avx512_bf16_axpy_u8_bf16, avx512_gemm_kernel, avx512_peak_probe};
+
+#endif
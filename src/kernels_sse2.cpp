@@ -0,0 +1,434 @@
+#include "../include/kernels.hpp"
+#include "../include/bf16.hpp"
+
+#ifdef KERNELS_X86
+#include <emmintrin.h>
+
+static float sse2_dot(const float *a, const float *b, size_t n)
+{
+    // four independent accumulators hide the add latency
+    __m128 sum0 = _mm_setzero_ps();
+    __m128 sum1 = _mm_setzero_ps();
+    __m128 sum2 = _mm_setzero_ps();
+    __m128 sum3 = _mm_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+        sum2 = _mm_add_ps(sum2, _mm_mul_ps(_mm_loadu_ps(a + i + 8), _mm_loadu_ps(b + i + 8)));
+        sum3 = _mm_add_ps(sum3, _mm_mul_ps(_mm_loadu_ps(a + i + 12), _mm_loadu_ps(b + i + 12)));
+    }
+    for (; i + 4 <= n; i += 4)
+    {
+        sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+
+    // horizontal sum of the accumulators
+    __m128 sum = _mm_add_ps(_mm_add_ps(sum0, sum1), _mm_add_ps(sum2, sum3));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    float result = _mm_cvtss_f32(sum);
+
+    for (; i < n; i++)
+    {
+        result += a[i] * b[i];
+    }
+    return result;
+}
+
+static void sse2_axpy(float alpha, const float *x, float *y, size_t n)
+{
+    __m128 scale = _mm_set1_ps(alpha);
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(scale, _mm_loadu_ps(x + i))));
+        _mm_storeu_ps(y + i + 4, _mm_add_ps(_mm_loadu_ps(y + i + 4), _mm_mul_ps(scale, _mm_loadu_ps(x + i + 4))));
+    }
+    for (; i < n; i++)
+    {
+        y[i] += alpha * x[i];
+    }
+}
+
+/*
+ * widen 4 pixels to floats
+ */
+static inline __m128 sse2_load_pixels(const uint8_t *x)
+{
+    int packed;
+    __builtin_memcpy(&packed, x, sizeof(packed));
+    __m128i zero = _mm_setzero_si128();
+    __m128i bytes = _mm_cvtsi32_si128(packed);
+    __m128i words = _mm_unpacklo_epi8(bytes, zero);
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero));
+}
+
+static float sse2_dot_u8(const float *a, const uint8_t *x, size_t n)
+{
+    __m128 sum0 = _mm_setzero_ps();
+    __m128 sum1 = _mm_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + i), sse2_load_pixels(x + i)));
+        sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), sse2_load_pixels(x + i + 4)));
+    }
+
+    __m128 sum = _mm_add_ps(sum0, sum1);
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    float result = _mm_cvtss_f32(sum);
+
+    for (; i < n; i++)
+    {
+        result += a[i] * x[i];
+    }
+    return result;
+}
+
+static void sse2_axpy_u8(float alpha, const uint8_t *x, float *y, size_t n)
+{
+    __m128 scale = _mm_set1_ps(alpha);
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(scale, sse2_load_pixels(x + i))));
+    }
+    for (; i < n; i++)
+    {
+        y[i] += alpha * x[i];
+    }
+}
+
+/*
+ * horizontal sum of 4 float lanes
+ */
+static inline float sse2_sum_ps(__m128 sum)
+{
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+static void sse2_dot4_u8(const float *a, size_t stride, const uint8_t *x, size_t n, float *sums)
+{
+    const float *a0 = a;
+    const float *a1 = a + stride;
+    const float *a2 = a + 2 * stride;
+    const float *a3 = a + 3 * stride;
+    __m128 sum0 = _mm_setzero_ps();
+    __m128 sum1 = _mm_setzero_ps();
+    __m128 sum2 = _mm_setzero_ps();
+    __m128 sum3 = _mm_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 pixels = sse2_load_pixels(x + i);
+        sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a0 + i), pixels));
+        sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(a1 + i), pixels));
+        sum2 = _mm_add_ps(sum2, _mm_mul_ps(_mm_loadu_ps(a2 + i), pixels));
+        sum3 = _mm_add_ps(sum3, _mm_mul_ps(_mm_loadu_ps(a3 + i), pixels));
+    }
+
+    sums[0] = sse2_sum_ps(sum0);
+    sums[1] = sse2_sum_ps(sum1);
+    sums[2] = sse2_sum_ps(sum2);
+    sums[3] = sse2_sum_ps(sum3);
+    for (; i < n; i++)
+    {
+        sums[0] += a0[i] * x[i];
+        sums[1] += a1[i] * x[i];
+        sums[2] += a2[i] * x[i];
+        sums[3] += a3[i] * x[i];
+    }
+}
+
+static void sse2_sum_columns_u8(const float *columns, size_t stride, const uint16_t *indices, const uint8_t *values,
+                                size_t count, float *y, size_t n)
+{
+    // a block of 32 outputs stays in registers while the columns stream past
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        __m128 sum0 = _mm_setzero_ps();
+        __m128 sum1 = _mm_setzero_ps();
+        __m128 sum2 = _mm_setzero_ps();
+        __m128 sum3 = _mm_setzero_ps();
+        __m128 sum4 = _mm_setzero_ps();
+        __m128 sum5 = _mm_setzero_ps();
+        __m128 sum6 = _mm_setzero_ps();
+        __m128 sum7 = _mm_setzero_ps();
+        for (size_t k = 0; k < count; k++)
+        {
+            const float *column = columns + indices[k] * stride + i;
+            __m128 value = _mm_set1_ps((float)values[k]);
+            sum0 = _mm_add_ps(sum0, _mm_mul_ps(value, _mm_loadu_ps(column)));
+            sum1 = _mm_add_ps(sum1, _mm_mul_ps(value, _mm_loadu_ps(column + 4)));
+            sum2 = _mm_add_ps(sum2, _mm_mul_ps(value, _mm_loadu_ps(column + 8)));
+            sum3 = _mm_add_ps(sum3, _mm_mul_ps(value, _mm_loadu_ps(column + 12)));
+            sum4 = _mm_add_ps(sum4, _mm_mul_ps(value, _mm_loadu_ps(column + 16)));
+            sum5 = _mm_add_ps(sum5, _mm_mul_ps(value, _mm_loadu_ps(column + 20)));
+            sum6 = _mm_add_ps(sum6, _mm_mul_ps(value, _mm_loadu_ps(column + 24)));
+            sum7 = _mm_add_ps(sum7, _mm_mul_ps(value, _mm_loadu_ps(column + 28)));
+        }
+        _mm_storeu_ps(y + i, sum0);
+        _mm_storeu_ps(y + i + 4, sum1);
+        _mm_storeu_ps(y + i + 8, sum2);
+        _mm_storeu_ps(y + i + 12, sum3);
+        _mm_storeu_ps(y + i + 16, sum4);
+        _mm_storeu_ps(y + i + 20, sum5);
+        _mm_storeu_ps(y + i + 24, sum6);
+        _mm_storeu_ps(y + i + 28, sum7);
+    }
+
+    // the outputs past the last block are summed column by column
+    for (size_t j = i; j < n; j++)
+    {
+        y[j] = 0.0f;
+    }
+    for (size_t k = 0; k < count; k++)
+    {
+        const float *column = columns + indices[k] * stride;
+        float value = values[k];
+        for (size_t j = i; j < n; j++)
+        {
+            y[j] += value * column[j];
+        }
+    }
+}
+
+static void sse2_update_columns_u8(float alpha, const float *x, size_t n, const uint16_t *indices,
+                                   const uint8_t *values, size_t count, float *columns, size_t stride)
+{
+    // a block of 32 inputs stays in registers while the columns are updated
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        __m128 x0 = _mm_loadu_ps(x + i);
+        __m128 x1 = _mm_loadu_ps(x + i + 4);
+        __m128 x2 = _mm_loadu_ps(x + i + 8);
+        __m128 x3 = _mm_loadu_ps(x + i + 12);
+        __m128 x4 = _mm_loadu_ps(x + i + 16);
+        __m128 x5 = _mm_loadu_ps(x + i + 20);
+        __m128 x6 = _mm_loadu_ps(x + i + 24);
+        __m128 x7 = _mm_loadu_ps(x + i + 28);
+        for (size_t k = 0; k < count; k++)
+        {
+            float *column = columns + indices[k] * stride + i;
+            __m128 scale = _mm_set1_ps(alpha * values[k]);
+            _mm_storeu_ps(column, _mm_add_ps(_mm_loadu_ps(column), _mm_mul_ps(scale, x0)));
+            _mm_storeu_ps(column + 4, _mm_add_ps(_mm_loadu_ps(column + 4), _mm_mul_ps(scale, x1)));
+            _mm_storeu_ps(column + 8, _mm_add_ps(_mm_loadu_ps(column + 8), _mm_mul_ps(scale, x2)));
+            _mm_storeu_ps(column + 12, _mm_add_ps(_mm_loadu_ps(column + 12), _mm_mul_ps(scale, x3)));
+            _mm_storeu_ps(column + 16, _mm_add_ps(_mm_loadu_ps(column + 16), _mm_mul_ps(scale, x4)));
+            _mm_storeu_ps(column + 20, _mm_add_ps(_mm_loadu_ps(column + 20), _mm_mul_ps(scale, x5)));
+            _mm_storeu_ps(column + 24, _mm_add_ps(_mm_loadu_ps(column + 24), _mm_mul_ps(scale, x6)));
+            _mm_storeu_ps(column + 28, _mm_add_ps(_mm_loadu_ps(column + 28), _mm_mul_ps(scale, x7)));
+        }
+    }
+
+    // the inputs past the last block are applied column by column
+    for (size_t k = 0; k < count; k++)
+    {
+        float *column = columns + indices[k] * stride;
+        float scale = alpha * values[k];
+        for (size_t j = i; j < n; j++)
+        {
+            column[j] += scale * x[j];
+        }
+    }
+}
+
+static int32_t sse2_dot_s8(const uint8_t *x, const int8_t *w, size_t n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(x + i));
+        __m128i weights = _mm_loadu_si128(reinterpret_cast<const __m128i *>(w + i));
+
+        // widen to 16 bits (sign extension by shifting the byte into the high half)
+        // pmaddwd is exact for 8-bit products, unlike the saturating pmaddubsw
+        __m128i x_lo = _mm_unpacklo_epi8(pixels, zero);
+        __m128i x_hi = _mm_unpackhi_epi8(pixels, zero);
+        __m128i w_lo = _mm_srai_epi16(_mm_unpacklo_epi8(weights, weights), 8);
+        __m128i w_hi = _mm_srai_epi16(_mm_unpackhi_epi8(weights, weights), 8);
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(x_lo, w_lo));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(x_hi, w_hi));
+    }
+
+    int32_t lanes[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), sum);
+    int32_t result = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+    for (; i < n; i++)
+    {
+        result += x[i] * w[i];
+    }
+    return result;
+}
+
+/*
+ * round 8 floats to bf16 (ties to even) and store them
+ */
+static inline void sse2_store_bf16(uint16_t *y, __m128 lo, __m128 hi)
+{
+    const __m128i bias = _mm_set1_epi32(0x7FFF);
+    const __m128i one = _mm_set1_epi32(1);
+    __m128i lo_bits = _mm_castps_si128(lo);
+    __m128i hi_bits = _mm_castps_si128(hi);
+    lo_bits = _mm_add_epi32(lo_bits, _mm_add_epi32(bias, _mm_and_si128(_mm_srli_epi32(lo_bits, 16), one)));
+    hi_bits = _mm_add_epi32(hi_bits, _mm_add_epi32(bias, _mm_and_si128(_mm_srli_epi32(hi_bits, 16), one)));
+
+    // the arithmetic shift keeps the values in int16 range, so the signed pack does not saturate
+    __m128i packed = _mm_packs_epi32(_mm_srai_epi32(lo_bits, 16), _mm_srai_epi32(hi_bits, 16));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(y), packed);
+}
+
+static float sse2_dot_bf16(const uint16_t *a, const uint16_t *b, size_t n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128 sum0 = _mm_setzero_ps();
+    __m128 sum1 = _mm_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        // a bf16 value shifted into the upper half of a lane is the fp32 value
+        __m128i a_words = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+        __m128i b_words = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+        sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_castsi128_ps(_mm_unpacklo_epi16(zero, a_words)),
+                                           _mm_castsi128_ps(_mm_unpacklo_epi16(zero, b_words))));
+        sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_castsi128_ps(_mm_unpackhi_epi16(zero, a_words)),
+                                           _mm_castsi128_ps(_mm_unpackhi_epi16(zero, b_words))));
+    }
+
+    __m128 sum = _mm_add_ps(sum0, sum1);
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    float result = _mm_cvtss_f32(sum);
+
+    for (; i < n; i++)
+    {
+        result += bf16_to_float(a[i]) * bf16_to_float(b[i]);
+    }
+    return result;
+}
+
+static void sse2_axpy_u8_bf16(float alpha, const uint8_t *x, float *y, uint16_t *y_bf16, size_t n)
+{
+    __m128 scale = _mm_set1_ps(alpha);
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128 lo = _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(scale, sse2_load_pixels(x + i)));
+        __m128 hi = _mm_add_ps(_mm_loadu_ps(y + i + 4), _mm_mul_ps(scale, sse2_load_pixels(x + i + 4)));
+        _mm_storeu_ps(y + i, lo);
+        _mm_storeu_ps(y + i + 4, hi);
+        sse2_store_bf16(y_bf16 + i, lo, hi);
+    }
+    for (; i < n; i++)
+    {
+        y[i] += alpha * x[i];
+        y_bf16[i] = float_to_bf16(y[i]);
+    }
+}
+
+static void sse2_gemm_kernel(size_t k, float alpha, const float *a_panel, const float *b_panel,
+                             float *c, size_t ldc, size_t mr, size_t nr)
+{
+    // 16 registers only fit a 6x8 tile, so the 16 columns are done in two halves
+    for (size_t half = 0; half < GEMM_NR; half += 8)
+    {
+        __m128 acc[GEMM_MR][2];
+    #pragma GCC unroll 6
+    for (size_t i = 0; i < GEMM_MR; i++)
+        {
+            acc[i][0] = _mm_setzero_ps();
+            acc[i][1] = _mm_setzero_ps();
+        }
+
+        for (size_t p = 0; p < k; p++)
+        {
+            const float *a = a_panel + p * GEMM_MR;
+            __m128 b0 = _mm_load_ps(b_panel + p * GEMM_NR + half);
+            __m128 b1 = _mm_load_ps(b_panel + p * GEMM_NR + half + 4);
+    #pragma GCC unroll 6
+    for (size_t i = 0; i < GEMM_MR; i++)
+            {
+                __m128 ai = _mm_set1_ps(a[i]);
+                acc[i][0] = _mm_add_ps(acc[i][0], _mm_mul_ps(ai, b0));
+                acc[i][1] = _mm_add_ps(acc[i][1], _mm_mul_ps(ai, b1));
+            }
+        }
+
+        // scale and add the tile to c, element-wise at the matrix edges
+        __m128 scale = _mm_set1_ps(alpha);
+        for (size_t i = 0; i < mr; i++)
+        {
+            float *c_row = c + i * ldc + half;
+            if (nr >= half + 8)
+            {
+                _mm_storeu_ps(c_row, _mm_add_ps(_mm_loadu_ps(c_row), _mm_mul_ps(scale, acc[i][0])));
+                _mm_storeu_ps(c_row + 4, _mm_add_ps(_mm_loadu_ps(c_row + 4), _mm_mul_ps(scale, acc[i][1])));
+            }
+            else if (nr > half)
+            {
+                float tile[8];
+                _mm_storeu_ps(tile, acc[i][0]);
+                _mm_storeu_ps(tile + 4, acc[i][1]);
+                for (size_t j = 0; j < nr - half; j++)
+                {
+                    c_row[j] += alpha * tile[j];
+                }
+            }
+        }
+    }
+}
+
+static double sse2_peak_probe(size_t iterations)
+{
+    // twelve independent multiply-add chains
+    __m128 acc[12];
+    #pragma GCC unroll 12
+    for (int i = 0; i < 12; i++)
+    {
+        acc[i] = _mm_set1_ps((float)i);
+    }
+    const __m128 scale = _mm_set1_ps(0.999999f);
+    const __m128 offset = _mm_set1_ps(1e-7f);
+
+    for (size_t it = 0; it < iterations; it++)
+    {
+    #pragma GCC unroll 12
+    for (int i = 0; i < 12; i++)
+        {
+            acc[i] = _mm_add_ps(_mm_mul_ps(acc[i], scale), offset);
+        }
+    }
+
+    __m128 sum = acc[0];
+    #pragma GCC unroll 12
+    for (int i = 1; i < 12; i++)
+    {
+        sum = _mm_add_ps(sum, acc[i]);
+    }
+    volatile float sink = _mm_cvtss_f32(sum);
+    (void)sink;
+    return 2.0 * 12 * 4 * iterations;
+}
+
+const KERNELS sse2_kernels = {"sse2", sse2_dot, sse2_axpy, sse2_dot_u8, sse2_axpy_u8, sse2_dot4_u8, sse2_sum_columns_u8, sse2_update_columns_u8, sse2_dot_s8, sse2_dot_bf16, sse2_axpy_u8_bf16, sse2_gemm_kernel, sse2_peak_probe};
+
+#endif
@@ -1,18 +1,21 @@
-#include "../include/mnist/mnist_reader.hpp"
-#include "../include/mnist/mnist_utils.hpp"
+#include "../include/idx_dataset.hpp"
 #include "../include/layer.hpp"
 #include "../include/evaluation.hpp"
 #include "../include/model.hpp"
+#include "../include/network.hpp"
+#include "../include/thread_pool.hpp"
+#include "../include/checkpoint.hpp"
+#include "../include/metrics.hpp"
+#include <getopt.h>
 #include <unistd.h>
 
-#define NUM_INPUTS 784
-#define NUM_WEIGHTS 784
-#define NUM_NEURONS 128
-#define NUM_OUTPUT_NEURONS 10
 #define NUM_EPOCHS 10
 #define LEARNING_RATE 0.001f
+#define BATCH_SIZE 1
 #define PARALLEL_OFF 0
 #define PARALLEL_ON 1
+#define HOGWILD_OFF 0
+#define SHUFFLE_SEED 1
 
 /*
  * print help message
@@ -23,20 +26,80 @@ void print_help()
               << "Options:\n"
               << "  -l <learning rate>  Specify the learning rate (positive float).\n"
               << "  -e <epochs>         Specify the number of epochs (positive integer).\n"
+              << "  -b <batch size>     Train in mini-batches of this size (positive integer, 1 = per-sample).\n"
               << "  -p                  Enable parallel computing.\n"
+              << "  -t <threads>        Number of threads for parallel computing (positive integer, implies -p).\n"
+              << "  --hogwild <workers> Train with lock-free asynchronous SGD on this many workers.\n"
+              << "  --seed <seed>       Seed of the shuffled sample order (non-negative integer).\n"
+              << "  --no-shuffle        Visit the training samples in file order.\n"
+              << "  --save <path>       Save the trained model to a checkpoint file.\n"
+              << "  --load <path>       Load a checkpoint instead of training (train further if -e is given).\n"
+              << "  --metrics <path>    Write the epoch throughput and phase timings to a JSON file.\n"
+              << "  --counters          Read hardware counters around every timed phase (make METRICS=1).\n"
               << "  -h                  Display this help message.\n"
               << std::endl;
 }
 
+/*
+ * check that images of the given size and labels up to max_label fit the network
+ */
+bool check_data(const std::string &name, size_t pixels, int max_label)
+{
+    if (pixels != NUM_INPUTS)
+    {
+        std::cout << "Error: " << name << " images have " << pixels << " pixels, the network expects " << NUM_INPUTS
+                  << "\n";
+        return false;
+    }
+    if (max_label >= NUM_OUTPUT_NEURONS)
+    {
+        std::cout << "Error: " << name << " label " << max_label << " is out of range, the network has "
+                  << NUM_OUTPUT_NEURONS << " classes\n";
+        return false;
+    }
+    return true;
+}
+
 int main(int argc, char **argv)
 {
     int opt;
     int epochs = NUM_EPOCHS;
     int parallel = PARALLEL_OFF;
     float learning_rate = LEARNING_RATE;
+    int threads = std::thread::hardware_concurrency();
+    int batch_size = BATCH_SIZE;
+    int hogwild = HOGWILD_OFF;
+    unsigned int seed = SHUFFLE_SEED;
+    bool shuffle = true;
+    bool epochs_given = false;
+    std::string save_path;
+    std::string load_path;
+    std::string metrics_path;
+    bool counters = false;
+
+    // long options without a short form
+    enum
+    {
+        OPTION_SAVE = 256,
+        OPTION_LOAD,
+        OPTION_HOGWILD,
+        OPTION_SEED,
+        OPTION_NO_SHUFFLE,
+        OPTION_METRICS,
+        OPTION_COUNTERS
+    };
+    static const struct option long_options[] = {
+        {"save", required_argument, nullptr, OPTION_SAVE},
+        {"load", required_argument, nullptr, OPTION_LOAD},
+        {"hogwild", required_argument, nullptr, OPTION_HOGWILD},
+        {"seed", required_argument, nullptr, OPTION_SEED},
+        {"no-shuffle", no_argument, nullptr, OPTION_NO_SHUFFLE},
+        {"metrics", required_argument, nullptr, OPTION_METRICS},
+        {"counters", no_argument, nullptr, OPTION_COUNTERS},
+        {nullptr, 0, nullptr, 0}};
 
     // handle CLI arguments
-    while ((opt = getopt(argc, argv, "e:l:ph")) != -1)
+    while ((opt = getopt_long(argc, argv, "e:l:b:pt:h", long_options, nullptr)) != -1)
     {
         switch (opt)
         {
@@ -47,6 +110,7 @@ int main(int argc, char **argv)
                 std::cout << "Error: Number of epochs must be a positive integer\n";
                 return 1;
             }
+            epochs_given = true;
             break;
         case 'l':
             learning_rate = std::atof(optarg);
@@ -56,9 +120,57 @@ int main(int argc, char **argv)
                 return 1;
             }
             break;
+        case 'b':
+            batch_size = std::atoi(optarg);
+            if (batch_size <= 0)
+            {
+                std::cout << "Error: Batch size must be a positive integer\n";
+                return 1;
+            }
+            break;
         case 'p':
             parallel = PARALLEL_ON;
             break;
+        case 't':
+            threads = std::atoi(optarg);
+            if (threads <= 0)
+            {
+                std::cout << "Error: Number of threads must be a positive integer\n";
+                return 1;
+            }
+            parallel = PARALLEL_ON;
+            break;
+        case OPTION_SAVE:
+            save_path = optarg;
+            break;
+        case OPTION_LOAD:
+            load_path = optarg;
+            break;
+        case OPTION_HOGWILD:
+            hogwild = std::atoi(optarg);
+            if (hogwild <= 0)
+            {
+                std::cout << "Error: Number of hogwild workers must be a positive integer\n";
+                return 1;
+            }
+            break;
+        case OPTION_SEED:
+            if (std::atoi(optarg) < 0)
+            {
+                std::cout << "Error: Seed must be a non-negative integer\n";
+                return 1;
+            }
+            seed = std::atoi(optarg);
+            break;
+        case OPTION_NO_SHUFFLE:
+            shuffle = false;
+            break;
+        case OPTION_METRICS:
+            metrics_path = optarg;
+            break;
+        case OPTION_COUNTERS:
+            counters = true;
+            break;
         case 'h':
             print_help();
             return 0;
@@ -68,23 +180,107 @@ int main(int argc, char **argv)
         }
     }
 
-    // load the MNIST dataset
-    mnist::MNIST_dataset<std::vector, std::vector<float>, int> dataset =
-        mnist::read_dataset<std::vector, std::vector, float, int>(MNIST_DATA_LOCATION);
+    // map the MNIST test set, the pixels stay 8-bit and are normalized inside the first layer kernels
+    IDX_DATASET dataset;
+    if (!load_idx_test_set(MNIST_DATA_LOCATION, dataset) ||
+        !check_data("test", dataset.test_images.pixels(), dataset.test_labels.max()))
+    {
+        return 1;
+    }
+
+    // a loaded model is only trained further when epochs are given
+    bool train = load_path.empty() || epochs_given;
 
-    // normalize the pixel values from 0-255 to 0-1
-    mnist::normalize_pixels(dataset);
+    // the training set is streamed in chunks, rounded to whole batches so only the smaller last chunk
+    // ends in a short batch, and visited in a new seeded order every epoch unless shuffling is off
+    // the non-zero pixel lists are only built for the per-sample network (one thread or hogwild workers)
+    // an evaluation-only run never opens the training files
+    IDX_STREAM training;
+    size_t chunk_samples = (STREAM_CHUNK_SAMPLES + batch_size - 1) / batch_size * batch_size;
+    bool sparse_inputs = batch_size == 1 && (hogwild != HOGWILD_OFF || !parallel || threads == 1);
+    if (train && (!training.open(std::string(MNIST_DATA_LOCATION) + "/train-images-idx3-ubyte",
+                                 std::string(MNIST_DATA_LOCATION) + "/train-labels-idx1-ubyte", chunk_samples,
+                                 shuffle, seed, sparse_inputs) ||
+                  !check_data("training", training.pixels(), training.max_label())))
+    {
+        return 1;
+    }
+
+    // the checkpoint mapping holds the loaded weights, so it is declared before the layers
+    CHECKPOINT checkpoint;
 
     // initialize layers and evaluation struct
     LAYER layer;
     LAYER output_layer;
-    layer.initialize_layer(NUM_INPUTS, NUM_NEURONS);
-    output_layer.initialize_layer(NUM_NEURONS, NUM_OUTPUT_NEURONS);
+    if (!load_path.empty())
+    {
+        if (!load_checkpoint(load_path, checkpoint, layer, output_layer, NUM_INPUTS, NUM_NEURONS, NUM_OUTPUT_NEURONS))
+        {
+            return 1;
+        }
+        std::cout << "Loaded model from " << load_path << std::endl;
+    }
+    else
+    {
+        layer.initialize_layer(NUM_INPUTS, NUM_NEURONS);
+        output_layer.initialize_layer(NUM_NEURONS, NUM_OUTPUT_NEURONS);
+    }
     EVALUATION eval;
 
-    // train the model
-    model_train(dataset, layer, output_layer, eval, epochs, NUM_NEURONS, NUM_OUTPUT_NEURONS, learning_rate, parallel);
-    model_evaluate(dataset, layer, output_layer, eval, NUM_NEURONS, NUM_OUTPUT_NEURONS, parallel);
+    if (hogwild != HOGWILD_OFF && batch_size > 1)
+    {
+        std::cout << "Error: --hogwild trains per sample and cannot be combined with -b\n";
+        return 1;
+    }
+
+    // create the worker threads once, a single-thread pool runs everything inline
+    // in hogwild mode every thread of the pool is one training worker
+    THREAD_POOL pool(hogwild != HOGWILD_OFF ? hogwild : parallel ? threads : 1);
+
+    // the counters follow the calling thread, which drives training and runs the first evaluation worker
+    if (counters)
+    {
+        open_counters();
+    }
+
+    // train the model, a model left partly trained by a failed read is neither saved nor evaluated
+    if (train)
+    {
+        bool trained;
+        if (hogwild != HOGWILD_OFF)
+        {
+            trained = model_train_hogwild(training, layer, output_layer, eval, epochs, NUM_NEURONS, NUM_OUTPUT_NEURONS, learning_rate, pool);
+        }
+        else
+        {
+            trained = model_train(training, layer, output_layer, eval, epochs, NUM_NEURONS, NUM_OUTPUT_NEURONS, learning_rate, batch_size, pool);
+        }
+        if (!trained)
+        {
+            return 1;
+        }
+    }
+
+    if (!save_path.empty())
+    {
+        if (!save_checkpoint(save_path, layer, output_layer))
+        {
+            return 1;
+        }
+        std::cout << "Saved model to " << save_path << std::endl;
+    }
+
+    model_evaluate(dataset.test(), layer, output_layer, eval, NUM_NEURONS, NUM_OUTPUT_NEURONS, pool);
+    print_phase_metrics();
+
+    if (!metrics_path.empty())
+    {
+        if (!write_metrics(metrics_path))
+        {
+            return 1;
+        }
+        std::cout << "Saved metrics to " << metrics_path << std::endl;
+    }
 
     return 0;
 }
\ No newline at end of file
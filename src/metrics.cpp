@@ -0,0 +1,308 @@
+#include "../include/metrics.hpp"
+#include "../include/kernels.hpp"
+#include "../include/layer.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static const char *phase_names[NUM_PHASES] = {
+    "stream_wait", "load_batch", "forward_feed", "feed_output", "softmax", "loss",
+    "backpropagate_output", "backpropagate_hidden", "train_step", "predict", "score"};
+
+METRICS metrics;
+
+METRICS::METRICS() : evaluated(false), flops_per_sample(0.0), batch_size(1), threads(1)
+{
+    std::memset(this->phases, 0, sizeof(this->phases));
+    std::memset(&this->evaluation, 0, sizeof(this->evaluation));
+    this->start_ticks = read_ticks();
+    this->start_time = std::chrono::steady_clock::now();
+}
+
+double training_flops(size_t inputs, size_t neurons, size_t classes)
+{
+    // forward: both layers, backward: output errors, output update, hidden update
+    double forward = 2.0 * (inputs * neurons + neurons * classes);
+    double backward = 2.0 * (neurons * classes + neurons * classes + inputs * neurons);
+    return forward + backward;
+}
+
+void record_epoch(int epoch, size_t samples, double time_ms, double average_loss)
+{
+    RUN_METRICS run = {epoch, samples, time_ms, average_loss, 0.0};
+    metrics.epochs.push_back(run);
+}
+
+void record_evaluation(size_t samples, double time_ms, double average_loss, double accuracy)
+{
+    RUN_METRICS run = {0, samples, time_ms, average_loss, accuracy};
+    metrics.evaluation = run;
+    metrics.evaluated = true;
+}
+
+void open_counters()
+{
+#ifdef ENABLE_METRICS
+    if (metrics.counters.open())
+    {
+        std::cout << "Hardware counters: enabled" << std::endl;
+    }
+#else
+    std::cout << "Hardware counters are read around the phase timers, rebuild with make METRICS=1 to use them"
+              << std::endl;
+#endif
+}
+
+/*
+ * nanoseconds per tick, measured over the run so far
+ */
+static double ns_per_tick()
+{
+    uint64_t ticks = read_ticks() - metrics.start_ticks;
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - metrics.start_time).count();
+    return ticks ? ns / ticks : 1.0;
+}
+
+/*
+ * upper bound in ticks of the histogram bucket holding the given fraction of the calls
+ */
+static double percentile_ticks(const PHASE_STATS &stats, double fraction)
+{
+    uint64_t target = (uint64_t)std::ceil(stats.calls * fraction);
+    uint64_t seen = 0;
+    for (int b = 0; b < HISTOGRAM_BUCKETS; b++)
+    {
+        seen += stats.histogram[b];
+        if (seen >= target && seen > 0)
+        {
+            return std::ldexp(1.0, b);
+        }
+    }
+    return std::ldexp(1.0, HISTOGRAM_BUCKETS - 1);
+}
+
+/*
+ * instructions per cycle of a phase, 0 when either counter is missing
+ */
+static double phase_ipc(const PHASE_STATS &stats)
+{
+    if (!metrics.counters.available(COUNTER_CYCLES) || !metrics.counters.available(COUNTER_INSTRUCTIONS) ||
+        stats.counters[COUNTER_CYCLES] == 0)
+    {
+        return 0.0;
+    }
+    return (double)stats.counters[COUNTER_INSTRUCTIONS] / stats.counters[COUNTER_CYCLES];
+}
+
+static uint64_t timed_ticks()
+{
+    uint64_t total = 0;
+    for (int p = 0; p < NUM_PHASES; p++)
+    {
+        total += metrics.phases[p].ticks;
+    }
+    return total;
+}
+
+void print_phase_metrics()
+{
+    uint64_t total = timed_ticks();
+    if (total == 0)
+    {
+        return;
+    }
+    double scale = ns_per_tick();
+
+    std::cout << std::endl
+              << "Time per phase (p50 / p99 are histogram bucket bounds):" << std::endl;
+    std::printf("%-22s %10s %10s %7s %10s %10s %10s\n", "phase", "calls", "total ms", "share", "mean ns", "p50 ns", "p99 ns");
+    for (int p = 0; p < NUM_PHASES; p++)
+    {
+        const PHASE_STATS &stats = metrics.phases[p];
+        if (stats.calls == 0)
+        {
+            continue;
+        }
+        std::printf("%-22s %10llu %10.1f %6.1f%% %10.0f %10.0f %10.0f\n", phase_names[p],
+                    (unsigned long long)stats.calls, stats.ticks * scale / 1e6, 100.0 * stats.ticks / total,
+                    stats.ticks * scale / stats.calls, percentile_ticks(stats, 0.5) * scale,
+                    percentile_ticks(stats, 0.99) * scale);
+    }
+
+    if (!metrics.counters.enabled())
+    {
+        return;
+    }
+
+    std::cout << std::endl
+              << "Hardware counters per sample" << (metrics.threads > 1 ? " (calling thread only)" : "") << ":"
+              << std::endl;
+    std::printf("%-22s %6s", "phase", "IPC");
+    for (int c = COUNTER_INSTRUCTIONS; c < NUM_COUNTERS; c++)
+    {
+        std::printf(" %14s", counter_names[c]);
+    }
+    std::printf("\n");
+
+    for (int p = 0; p < NUM_PHASES; p++)
+    {
+        const PHASE_STATS &stats = metrics.phases[p];
+        if (stats.samples == 0)
+        {
+            continue;
+        }
+        if (phase_ipc(stats) > 0.0)
+        {
+            std::printf("%-22s %6.2f", phase_names[p], phase_ipc(stats));
+        }
+        else
+        {
+            std::printf("%-22s %6s", phase_names[p], "n/a");
+        }
+        for (int c = COUNTER_INSTRUCTIONS; c < NUM_COUNTERS; c++)
+        {
+            if (metrics.counters.available(c))
+            {
+                std::printf(" %14.1f", (double)stats.counters[c] / stats.samples);
+            }
+            else
+            {
+                std::printf(" %14s", "n/a");
+            }
+        }
+        std::printf("\n");
+    }
+    if (metrics.counters.multiplexed())
+    {
+        std::cout << "The counters were multiplexed with other events, the counts are partial" << std::endl;
+    }
+}
+
+/*
+ * write one epoch or evaluation pass as a JSON object
+ */
+static void write_run(std::ofstream &out, const RUN_METRICS &run, bool evaluation)
+{
+    double seconds = run.time_ms / 1000.0;
+    out << "{\"samples\": " << run.samples << ", \"time_ms\": " << run.time_ms
+        << ", \"samples_per_s\": " << (seconds > 0.0 ? run.samples / seconds : 0.0)
+        << ", \"average_loss\": " << run.average_loss;
+    if (evaluation)
+    {
+        out << ", \"accuracy\": " << run.accuracy;
+    }
+    else
+    {
+        out << ", \"epoch\": " << run.epoch << ", \"gflop_per_s\": "
+            << (seconds > 0.0 ? run.samples * metrics.flops_per_sample / seconds / 1e9 : 0.0);
+    }
+    out << "}";
+}
+
+bool write_metrics(const std::string &path)
+{
+    std::ofstream out(path.c_str());
+    if (!out)
+    {
+        std::cout << "Error: could not write metrics to " << path << std::endl;
+        return false;
+    }
+
+    double scale = ns_per_tick();
+    uint64_t total = timed_ticks();
+
+#ifdef ENABLE_METRICS
+    const char *timers = "true";
+#else
+    const char *timers = "false";
+#endif
+
+    out << "{\n  \"kernels\": \"" << kernels->name << "\",\n"
+        << "  \"precision\": \"" << (sizeof(working_t) == sizeof(float) ? "fp32" : "bf16") << "\",\n"
+        << "  \"batch_size\": " << metrics.batch_size << ",\n"
+        << "  \"threads\": " << metrics.threads << ",\n"
+        << "  \"flops_per_sample\": " << metrics.flops_per_sample << ",\n"
+        << "  \"phase_timers\": " << timers << ",\n"
+        << "  \"hardware_counters\": " << (metrics.counters.enabled() ? "true" : "false") << ",\n"
+        << "  \"epochs\": [\n";
+    for (size_t i = 0; i < metrics.epochs.size(); i++)
+    {
+        out << "    ";
+        write_run(out, metrics.epochs[i], false);
+        out << (i + 1 < metrics.epochs.size() ? ",\n" : "\n");
+    }
+    out << "  ],\n  \"evaluation\": ";
+    if (metrics.evaluated)
+    {
+        write_run(out, metrics.evaluation, true);
+    }
+    else
+    {
+        out << "null";
+    }
+
+    out << ",\n  \"phases\": [\n";
+    bool first = true;
+    for (int p = 0; p < NUM_PHASES; p++)
+    {
+        const PHASE_STATS &stats = metrics.phases[p];
+        if (stats.calls == 0)
+        {
+            continue;
+        }
+        out << (first ? "" : ",\n") << "    {\"name\": \"" << phase_names[p] << "\", \"calls\": " << stats.calls
+            << ", \"samples\": " << stats.samples
+            << ", \"total_ms\": " << stats.ticks * scale / 1e6 << ", \"share\": " << (double)stats.ticks / total
+            << ", \"mean_ns\": " << stats.ticks * scale / stats.calls
+            << ", \"p50_ns\": " << percentile_ticks(stats, 0.5) * scale
+            << ", \"p99_ns\": " << percentile_ticks(stats, 0.99) * scale << ", \"histogram\": [";
+
+        // only the populated buckets, as upper bound in ns and count
+        bool first_bucket = true;
+        for (int b = 0; b < HISTOGRAM_BUCKETS; b++)
+        {
+            if (stats.histogram[b] == 0)
+            {
+                continue;
+            }
+            out << (first_bucket ? "" : ", ") << "{\"le_ns\": " << std::ldexp(1.0, b) * scale
+                << ", \"count\": " << stats.histogram[b] << "}";
+            first_bucket = false;
+        }
+        out << "]";
+
+        // raw counts and per-sample rates of the counters that could be opened
+        if (metrics.counters.enabled())
+        {
+            out << ", \"counters\": {";
+            if (phase_ipc(stats) > 0.0)
+            {
+                out << "\"ipc\": " << phase_ipc(stats);
+            }
+            else
+            {
+                out << "\"ipc\": null";
+            }
+            for (int c = 0; c < NUM_COUNTERS; c++)
+            {
+                if (!metrics.counters.available(c))
+                {
+                    continue;
+                }
+                out << ", \"" << counter_names[c] << "\": " << stats.counters[c];
+                if (stats.samples > 0)
+                {
+                    out << ", \"" << counter_names[c] << "_per_sample\": " << (double)stats.counters[c] / stats.samples;
+                }
+            }
+            out << "}";
+        }
+        out << "}";
+        first = false;
+    }
+    out << (first ? "" : "\n") << "  ]\n}\n";
+
+    return true;
+}
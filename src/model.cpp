@@ -1,23 +1,386 @@
 #include "../include/model.hpp"
+#include "../include/kernels.hpp"
+#include "../include/alloc_counter.hpp"
+#include "../include/quantized_engine.hpp"
+#include "../include/metrics.hpp"
+#include "../include/network.hpp"
+#include <algorithm>
+
+/*
+ * hand out the next chunk of the stream, the time spent waiting for it is recorded
+ */
+static bool next_chunk(IDX_STREAM &training, IDX_CHUNK &chunk)
+{
+    TIME_PHASE_SAMPLES(PHASE_STREAM_WAIT, 0);
+    return training.next(chunk);
+}
+
+/*
+ * input format of the chunks of one epoch
+ * a chunk whose lists were built and whose density is at most SPARSE_INPUT_DENSITY is trained
+ * on its non-zero pixels, the hidden weights then sit in the transposed columns of the layer
+ * until a dense chunk or the end of the epoch moves them back into the rows
+ */
+struct INPUT_FORMAT
+{
+    bool columns_loaded;
+    size_t chunks;
+    size_t sparse_chunks;
+    size_t nonzeros; // over the chunks with lists
+    size_t pixels;
+
+    INPUT_FORMAT() : columns_loaded(false), chunks(0), sparse_chunks(0), nonzeros(0), pixels(0) {}
+
+    /*
+     * true when the chunk is trained on sparse inputs, moves the weights to the matching layout
+     */
+    bool select(const IDX_CHUNK &chunk, LAYER &layer)
+    {
+        this->chunks++;
+        bool sparse = false;
+        if (chunk.sparse)
+        {
+            this->nonzeros += chunk.sparse->indices.size();
+            this->pixels += chunk.sparse->size() * chunk.sparse->pixels;
+            sparse = chunk.sparse->density() <= SPARSE_INPUT_DENSITY;
+        }
+
+        if (sparse != this->columns_loaded)
+        {
+            if (sparse)
+            {
+                layer.load_columns();
+            }
+            else
+            {
+                layer.store_columns();
+            }
+            this->columns_loaded = sparse;
+        }
+        this->sparse_chunks += sparse;
+        return sparse;
+    }
+
+    /*
+     * move the weights back into the rows at the end of the epoch
+     */
+    void store(LAYER &layer)
+    {
+        if (this->columns_loaded)
+        {
+            layer.store_columns();
+            this->columns_loaded = false;
+        }
+    }
+
+    /*
+     * print the formats used by the epoch and reset the counts
+     */
+    void print()
+    {
+        if (this->pixels > 0)
+        {
+            std::cout << std::endl
+                      << "sparse inputs: " << this->sparse_chunks << "/" << this->chunks << " chunks, density "
+                      << 100.0 * this->nonzeros / this->pixels << "% (threshold " << 100.0 * SPARSE_INPUT_DENSITY
+                      << "%)";
+        }
+        this->chunks = this->sparse_chunks = this->nonzeros = this->pixels = 0;
+    }
+};
+
+/*
+ * hidden neurons left active by the ReLU over the samples of an epoch
+ * the per-sample paths only backpropagate those, the others skip their error sum and weight update
+ */
+struct HIDDEN_ACTIVITY
+{
+    uint64_t active;
+    uint64_t neurons;
+
+    HIDDEN_ACTIVITY() : active(0), neurons(0) {}
+
+    void add(uint64_t active, uint64_t samples, int num_neurons)
+    {
+        this->active += active;
+        this->neurons += samples * num_neurons;
+    }
+
+    /*
+     * print the active share of the epoch and reset the counts
+     */
+    void print()
+    {
+        if (this->neurons > 0)
+        {
+            std::cout << std::endl
+                      << "active hidden neurons: " << 100.0 * this->active / this->neurons << "% ("
+                      << this->neurons - this->active << " neuron updates skipped)";
+        }
+        this->active = this->neurons = 0;
+    }
+};
+
+/*
+ * runs one epoch of mini-batch training over the chunks of the stream
+ * the chunk size is a multiple of the batch size, so only the last batch can be short
+ * returns the summed loss of the epoch
+ */
+static double train_epoch_batch(IDX_STREAM &training, LAYER &layer, LAYER &output_layer, BATCH &batch,
+                                std::vector<GRADIENTS> &gradients, PROGRESS_REPORTER &progress, int batch_size,
+                                float learning_rate, THREAD_POOL &pool)
+{
+    double total_loss = 0.0;
+    IDX_CHUNK chunk;
+    while (next_chunk(training, chunk))
+    {
+        size_t num_samples = chunk.samples.size();
+
+        for (size_t start = 0; start < num_samples; start += batch_size)
+        {
+            size_t count = std::min((size_t)batch_size, num_samples - start);
+            {
+                TIME_PHASE_SAMPLES(PHASE_LOAD_BATCH, count);
+                load_batch(batch, chunk.samples, start, count);
+            }
+
+            if (pool.size() > 1)
+            {
+                // split the batch across the threads and apply the reduced gradients once
+                TIME_PHASE_SAMPLES(PHASE_TRAIN_STEP, count);
+                train_batch_parallel(layer, output_layer, batch, gradients, learning_rate, pool);
+            }
+            else
+            {
+                {
+                    TIME_PHASE_SAMPLES(PHASE_FORWARD_FEED, count);
+                    forward_feed_batch(&layer, batch);
+                }
+                {
+                    TIME_PHASE_SAMPLES(PHASE_FEED_OUTPUT, count);
+                    feed_output_batch(&output_layer, batch);
+                }
+                {
+                    // perform softmax
+                    TIME_PHASE_SAMPLES(PHASE_SOFTMAX, count);
+                    softmax_batch(batch.rows(batch.outputs));
+                }
+                {
+                    // backpropagate the output layer, the hidden errors are taken before its update
+                    TIME_PHASE_SAMPLES(PHASE_BACKPROPAGATE_OUTPUT, count);
+                    backpropagate_output_batch(output_layer, batch, learning_rate);
+                }
+                {
+                    TIME_PHASE_SAMPLES(PHASE_BACKPROPAGATE_HIDDEN, count);
+                    backpropagate_hidden_batch(layer, batch, learning_rate);
+                }
+            }
+
+            // calculate loss, the probabilities are left in the batch
+            {
+                TIME_PHASE_SAMPLES(PHASE_LOSS, count);
+                for (size_t r = 0; r < count; r++)
+                {
+                    total_loss += sparse_cross_entropy_loss(batch.outputs.row(r), batch.labels[r]);
+                }
+            }
+            progress.publish(0, chunk.first + start + count, total_loss);
+        }
+    }
+    return total_loss;
+}
+
+/*
+ * one timed training step of the compile-time network on the raw pixels or the sparse lists of a sample
+ * returns the loss of the sample
+ */
+template <typename INPUT>
+static float train_network_step(MNIST_NETWORK &network, const INPUT &input, int label, float learning_rate)
+{
+    float loss;
+    {
+        TIME_PHASE(PHASE_FORWARD_FEED);
+        network.forward_feed(input);
+    }
+    {
+        TIME_PHASE(PHASE_FEED_OUTPUT);
+        network.feed_output();
+    }
+    {
+        TIME_PHASE(PHASE_SOFTMAX);
+        network.softmax();
+    }
+    {
+        TIME_PHASE(PHASE_LOSS);
+        loss = network.loss(label);
+    }
+    {
+        TIME_PHASE(PHASE_BACKPROPAGATE_OUTPUT);
+        network.backpropagate_output(label, learning_rate);
+    }
+    {
+        TIME_PHASE(PHASE_BACKPROPAGATE_HIDDEN);
+        network.backpropagate_hidden(input, learning_rate);
+    }
+    return loss;
+}
+
+/*
+ * runs one epoch of per-sample training with the compile-time network
+ * every chunk is trained on the input format chosen for it
+ * returns the summed loss of the epoch
+ */
+static double train_epoch_network(IDX_STREAM &training, LAYER &layer, MNIST_NETWORK &network, INPUT_FORMAT &format,
+                                  HIDDEN_ACTIVITY &activity, PROGRESS_REPORTER &progress, float learning_rate)
+{
+    double total_loss = 0.0;
+    IDX_CHUNK chunk;
+    while (next_chunk(training, chunk))
+    {
+        const DATASET_VIEW &samples = chunk.samples;
+        bool sparse = format.select(chunk, layer);
+
+        for (size_t i = 0; i < samples.size(); i++)
+        {
+            size_t sample_index = chunk.first + i;
+            int label = samples.label(i);
+
+            // the shuffled samples are scattered, fetch the upcoming one ahead of its forward pass
+            if (sparse)
+            {
+                if (i + PREFETCH_SAMPLES < samples.size())
+                {
+                    chunk.sparse->prefetch(samples.index(i + PREFETCH_SAMPLES));
+                }
+                total_loss += train_network_step(network, chunk.sparse->image(samples.index(i)), label, learning_rate);
+            }
+            else
+            {
+                samples.prefetch(i + PREFETCH_SAMPLES);
+                total_loss += train_network_step(network, samples.input(i), label, learning_rate);
+            }
+            activity.add(network.active_neurons(), 1, NUM_NEURONS);
+            progress.publish(0, sample_index + 1, total_loss);
+        }
+    }
+    format.store(layer);
+    return total_loss;
+}
+
+/*
+ * runs one epoch of per-sample training over the chunks of the stream
+ * with more than one thread every sample is split across the pool by neurons
+ * returns the summed loss of the epoch
+ */
+static double train_epoch_samples(IDX_STREAM &training, LAYER &layer, LAYER &output_layer, WORKSPACE &workspace,
+                                  HIDDEN_ACTIVITY &activity, PROGRESS_REPORTER &progress, int num_neurons,
+                                  int num_classes, float learning_rate, THREAD_POOL &pool)
+{
+    double total_loss = 0.0;
+    IDX_CHUNK chunk;
+    while (next_chunk(training, chunk))
+    {
+        const DATASET_VIEW &samples = chunk.samples;
+
+        for (size_t i = 0; i < samples.size(); i++)
+        {
+            size_t sample_index = chunk.first + i;
+            const uint8_t *input = samples.input(i);
+            int label = samples.label(i);
+
+            // the shuffled rows are scattered, fetch the upcoming one ahead of its forward pass
+            samples.prefetch(i + PREFETCH_SAMPLES);
+
+            {
+                TIME_PHASE(PHASE_FORWARD_FEED);
+                if (pool.size() > 1)
+                {
+                    forward_feed_parallel(&layer, input, num_neurons, pool);
+                }
+                else
+                {
+                    forward_feed(&layer, input, num_neurons);
+                }
+            }
+            {
+                TIME_PHASE(PHASE_FEED_OUTPUT);
+                feed_output(&output_layer, &layer, num_classes);
+            }
+            {
+                // perform softmax
+                TIME_PHASE(PHASE_SOFTMAX);
+                softmax(&output_layer, num_classes);
+            }
+            {
+                // calculate loss
+                TIME_PHASE(PHASE_LOSS);
+                total_loss += sparse_cross_entropy_loss(output_layer.outputs, label);
+            }
+
+            // backpropagate the output layer, then the hidden layer
+            if (pool.size() > 1)
+            {
+                {
+                    TIME_PHASE(PHASE_BACKPROPAGATE_OUTPUT);
+                    backpropagate_output_parallel(output_layer, layer, label, learning_rate, pool);
+                }
+                TIME_PHASE(PHASE_BACKPROPAGATE_HIDDEN);
+                backpropagate_hidden_parallel(layer, output_layer, input, learning_rate, workspace, pool);
+            }
+            else
+            {
+                {
+                    TIME_PHASE(PHASE_BACKPROPAGATE_OUTPUT);
+                    backpropagate_output(output_layer, layer, label, learning_rate);
+                }
+                TIME_PHASE(PHASE_BACKPROPAGATE_HIDDEN);
+                backpropagate_hidden(layer, output_layer, input, learning_rate, workspace);
+            }
+            activity.add(layer.num_active, 1, num_neurons);
+            progress.publish(0, sample_index + 1, total_loss);
+        }
+    }
+    return total_loss;
+}
+
+/*
+ * print the heap allocations made since the snapshot
+ * the training loop should not allocate once the workspace is set up
+ */
+static void print_allocations(const ALLOCATION_STATS &since)
+{
+    ALLOCATION_STATS now = allocation_stats();
+    std::cout << std::endl
+              << "heap allocations: " << now.allocations - since.allocations
+              << " (" << now.bytes - since.bytes << " bytes)";
+}
 
 /**
  * trains the model using the training dataset
  */
-void model_train(mnist::MNIST_dataset<std::vector, std::vector<float>, int> dataset, LAYER &layer,
-                 LAYER &output_layer, EVALUATION eval, int num_epochs, int num_neurons, int num_classes, float learning_rate, int parallel)
+bool model_train(IDX_STREAM &training, LAYER &layer,
+                 LAYER &output_layer, EVALUATION &eval, int num_epochs, int num_neurons, int num_classes, float learning_rate,
+                 int batch_size, THREAD_POOL &pool)
 {
     std::cout << "----------------------------------------"
               << std::endl;
     std::cout << "Training model on the training dataset\n";
     std::cout << "----------------------------------------"
               << std::endl;
-    std::cout << "Number of samples: " << dataset.training_images.size() << std::endl;
+    std::cout << "Number of samples: " << training.size() << std::endl;
     std::cout << "Number of epochs: " << num_epochs << std::endl;
     std::cout << "Learning rate: " << learning_rate << std::endl;
+    std::cout << "Batch size: " << batch_size << std::endl;
+    std::cout << "Vector kernels: " << kernels->name << std::endl;
+    std::cout << "Working precision: " << (sizeof(working_t) == sizeof(float) ? "fp32" : "bf16") << std::endl;
+
+    // per-sample training on one thread runs the compile-time network when the layers have its shape
+    bool specialized = batch_size == 1 && pool.size() == 1 && MNIST_NETWORK::matches(layer, output_layer);
+    std::cout << "Network dimensions: " << (specialized ? "compile-time" : "runtime") << std::endl;
 
-    if (parallel)
+    if (pool.size() > 1)
     {
-        std::cout << "Parallel computing: enabled" << std::endl;
+        std::cout << "Parallel computing: enabled (" << pool.size() << " threads)" << std::endl;
     }
     else
     {
@@ -26,97 +389,365 @@ void model_train(mnist::MNIST_dataset<std::vector, std::vector<float>, int> data
 
     std::cout << std::endl;
 
-    for (int epoch = 1; epoch <= num_epochs; epoch++)
+    // mini-batch buffers and step temporaries, allocated once for all epochs
+    BATCH batch;
+    std::vector<GRADIENTS> gradients;
+    if (batch_size > 1)
     {
-        eval.start_timer();
-        // iterate over the training set
-        for (size_t sample_index = 0; sample_index < dataset.training_images.size(); sample_index++)
+        batch.initialize_batch(batch_size, layer.weights.cols, num_neurons, num_classes);
+    }
+    if (batch_size > 1 && pool.size() > 1)
+    {
+        // one gradient buffer per thread for data-parallel training
+        gradients.resize(pool.size());
+        for (size_t t = 0; t < gradients.size(); t++)
         {
-            if (parallel)
-            {
-                forward_feed_parallel(&layer, dataset.training_images, sample_index, num_neurons);
-            }
-            else
-            {
-                forward_feed(&layer, dataset.training_images, sample_index, num_neurons);
-            }
-
-            feed_output(&output_layer, &layer, num_classes);
+            gradients[t].initialize_gradients(layer.weights.cols, num_neurons, num_classes);
+        }
+    }
+    WORKSPACE workspace;
+    workspace.initialize_workspace(layer.weights.cols, num_neurons, num_classes);
+    eval.initialize_loss();
 
-            // perform softmax
-            output_layer.outputs = softmax(&output_layer, num_classes);
+    // the progress line is drawn by its own thread from the counters published by the loop
+    PROGRESS_REPORTER progress;
+    INPUT_FORMAT format;
+    HIDDEN_ACTIVITY activity;
 
-            // calculate loss
-            float loss = sparse_cross_entropy_loss(output_layer.outputs, dataset.training_labels[sample_index]);
+    metrics.flops_per_sample = training_flops(layer.weights.cols, num_neurons, num_classes);
+    metrics.batch_size = batch_size;
+    metrics.threads = pool.size();
 
-            eval.set_loss(loss, sample_index);
+    for (int epoch = 1; epoch <= num_epochs; epoch++)
+    {
+        ALLOCATION_STATS allocations = allocation_stats();
+        progress.start(training.size(), epoch, 1);
+        eval.start_timer();
 
-            // backpropagate the output layer
-            backpropagate_output(output_layer, layer, (int)dataset.training_labels[sample_index], learning_rate);
-            backpropagate_hidden(layer, output_layer, dataset, sample_index, learning_rate);
+        double total_loss;
+        if (batch_size > 1)
+        {
+            total_loss = train_epoch_batch(training, layer, output_layer, batch, gradients, progress, batch_size,
+                                           learning_rate, pool);
 
-            // display progress (remove for faster training)
-            if (sample_index % 1000 == 0)
-            {
-                progress_bar(sample_index, dataset.training_images.size(), epoch);
-            }
+            // the batch updates only touch the fp32 weights
+            layer.sync_working();
+        }
+        else if (specialized)
+        {
+            MNIST_NETWORK network(layer, output_layer);
+            total_loss = train_epoch_network(training, layer, network, format, activity, progress, learning_rate);
+        }
+        else
+        {
+            total_loss = train_epoch_samples(training, layer, output_layer, workspace, activity, progress,
+                                             num_neurons, num_classes, learning_rate, pool);
         }
 
         eval.end_timer();
-        eval.print_training_metrics();
+        progress.stop();
+        eval.set_loss(total_loss, training.size());
+        print_allocations(allocations);
+        format.print();
+        activity.print();
+        eval.print_training_metrics(training.size());
+        record_epoch(epoch, training.size(), eval.elapsed.count(), eval.average_loss);
         eval.initialize_loss();
+
+        if (training.failed())
+        {
+            return false;
+        }
     }
+    return true;
 }
 
 /*
- * evaluates model by using the validation dataset
+ * one hogwild worker's pass over its shard of a chunk, step(i) trains sample i and returns its loss
+ * the progress slot of the worker gets its totals including the samples and loss of earlier chunks
+ * returns the summed loss of the shard
+ */
+template <typename STEP>
+static double train_shard(const DATASET_VIEW &shard, PROGRESS_REPORTER &progress, int worker, uint64_t trained,
+                          double trained_loss, STEP step)
+{
+    double loss = 0.0;
+    for (size_t i = 0; i < shard.size(); i++)
+    {
+        loss += step(i);
+        progress.publish(worker, trained + i + 1, trained_loss + loss);
+    }
+    return loss;
+}
+
+/*
+ * trains the model with lock-free asynchronous SGD
  */
-void model_evaluate(mnist::MNIST_dataset<std::vector, std::vector<float>, int> dataset, LAYER &layer,
-                    LAYER &output_layer, EVALUATION eval, int num_neurons, int num_classes, int parallel)
+bool model_train_hogwild(IDX_STREAM &training, LAYER &layer,
+                         LAYER &output_layer, EVALUATION &eval, int num_epochs, int num_neurons, int num_classes,
+                         float learning_rate, THREAD_POOL &pool)
 {
+    int num_workers = pool.size();
+    size_t num_samples = training.size();
+
     std::cout << "----------------------------------------"
               << std::endl;
-    std::cout << "Evaluating model on the validation dataset\n";
+    std::cout << "Training model on the training dataset\n";
     std::cout << "----------------------------------------"
               << std::endl;
-    std::cout << "Number of samples: " << dataset.test_images.size() << std::endl
-              << std::endl;
+    std::cout << "Number of samples: " << num_samples << std::endl;
+    std::cout << "Number of epochs: " << num_epochs << std::endl;
+    std::cout << "Learning rate: " << learning_rate << std::endl;
+    std::cout << "Vector kernels: " << kernels->name << std::endl;
+    std::cout << "Hogwild workers: " << num_workers << std::endl;
 
+    // every worker runs its own compile-time network over the shared layers when they have its shape
+    bool specialized = MNIST_NETWORK::matches(layer, output_layer);
+    std::cout << "Network dimensions: " << (specialized ? "compile-time" : "runtime") << std::endl;
+    std::cout << std::endl;
+
+    metrics.flops_per_sample = training_flops(layer.weights.cols, num_neurons, num_classes);
+    metrics.batch_size = 1;
+    metrics.threads = num_workers;
+
+    // private activations and loss sums for every worker
+    std::vector<WORKSPACE> workspaces(num_workers);
+    for (int w = 0; w < num_workers; w++)
+    {
+        workspaces[w].initialize_workspace(layer.weights.cols, num_neurons, num_classes);
+    }
+    std::vector<double> losses(num_workers);
+    std::vector<uint64_t> trained(num_workers);
+    std::vector<uint64_t> active(num_workers);
     eval.initialize_loss();
-    std::vector<int> predictions;
 
-    for (size_t sample_index = 0; sample_index < dataset.test_images.size(); sample_index++)
+    // every worker publishes its own progress slot, the reporter thread adds them up
+    PROGRESS_REPORTER progress;
+    INPUT_FORMAT format;
+    HIDDEN_ACTIVITY activity;
+
+    for (int epoch = 1; epoch <= num_epochs; epoch++)
     {
-        if (parallel)
+        ALLOCATION_STATS allocations = allocation_stats();
+        progress.start(num_samples, epoch, num_workers);
+        eval.start_timer();
+        std::fill(losses.begin(), losses.end(), 0.0);
+        std::fill(trained.begin(), trained.end(), 0);
+        std::fill(active.begin(), active.end(), 0);
+
+        // every worker trains on its own shard of each chunk and updates the shared weights without locks
+        IDX_CHUNK chunk;
+        while (next_chunk(training, chunk))
         {
-            forward_feed_parallel(&layer, dataset.test_images, sample_index, num_neurons);
+            // the format is chosen before the workers start, they all train on the same weight layout
+            bool sparse = specialized && format.select(chunk, layer);
+
+            TIME_PHASE_SAMPLES(PHASE_TRAIN_STEP, chunk.samples.size());
+            pool.parallel_for(0, num_workers, [&](int first, int last)
+                              {
+                for (int w = first; w < last; w++)
+                {
+                    const DATASET_VIEW shard = chunk.samples.shard(w, num_workers);
+                    double loss;
+
+                    if (specialized)
+                    {
+                        MNIST_NETWORK network(layer, output_layer);
+                        uint64_t active_neurons = 0;
+                        if (sparse)
+                        {
+                            loss = train_shard(shard, progress, w, trained[w], losses[w], [&](size_t i) -> float
+                                               {
+                                if (i + PREFETCH_SAMPLES < shard.size())
+                                {
+                                    chunk.sparse->prefetch(shard.index(i + PREFETCH_SAMPLES));
+                                }
+                                float sample_loss = network.train(chunk.sparse->image(shard.index(i)), shard.label(i),
+                                                                  learning_rate);
+                                active_neurons += network.active_neurons();
+                                return sample_loss; });
+                        }
+                        else
+                        {
+                            loss = train_shard(shard, progress, w, trained[w], losses[w], [&](size_t i) -> float
+                                               {
+                                shard.prefetch(i + PREFETCH_SAMPLES);
+                                float sample_loss = network.train(shard.input(i), shard.label(i), learning_rate);
+                                active_neurons += network.active_neurons();
+                                return sample_loss; });
+                        }
+                        active[w] += active_neurons;
+                    }
+                    else
+                    {
+                        uint64_t active_neurons = 0;
+                        loss = train_shard(shard, progress, w, trained[w], losses[w], [&](size_t i) -> float
+                                           {
+                            shard.prefetch(i + PREFETCH_SAMPLES);
+                            float sample_loss = train_sample(layer, output_layer, shard.input(i), shard.label(i),
+                                                             learning_rate, workspaces[w]);
+                            active_neurons += workspaces[w].num_active;
+                            return sample_loss; });
+                        active[w] += active_neurons;
+                    }
+                    losses[w] += loss;
+                    trained[w] += shard.size();
+                } });
         }
-        else
+        format.store(layer);
+
+        double total_loss = 0.0;
+        for (int w = 0; w < num_workers; w++)
         {
-            forward_feed(&layer, dataset.test_images, sample_index, num_neurons);
+            total_loss += losses[w];
+            activity.add(active[w], trained[w], num_neurons);
         }
 
-        feed_output(&output_layer, &layer, num_classes);
+        eval.end_timer();
+        progress.stop();
+        eval.set_loss(total_loss, num_samples);
+        print_allocations(allocations);
+        format.print();
+        activity.print();
+        eval.print_training_metrics(num_samples);
+        record_epoch(epoch, num_samples, eval.elapsed.count(), eval.average_loss);
+        eval.initialize_loss();
+
+        if (training.failed())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * quantizes the hidden layer to int8 and compares it with the fp32 evaluation
+ */
+static void evaluate_quantized(const DATASET_VIEW &test, LAYER &layer, LAYER &output_layer,
+                               double fp32_accuracy, double fp32_ms)
+{
+    const IMAGE_TENSOR images = test.tensor();
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    // calibrate the per-row scales on the first test images
+    QuantizedInferenceEngine engine(layer, output_layer, images);
+    std::chrono::high_resolution_clock::time_point calibrated = std::chrono::high_resolution_clock::now();
 
-        // perform softmax
-        output_layer.outputs = softmax(&output_layer, num_classes);
+    std::vector<int> predictions(images.size());
+    engine.predict(images.data, images.size(), images.stride, predictions.data(), nullptr);
+    std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
 
-        int prediction = max_value_index(output_layer.outputs);
-        predictions.push_back(prediction);
+    size_t correct = 0;
+    for (size_t i = 0; i < predictions.size(); i++)
+    {
+        if (predictions[i] == test.label(i))
+        {
+            correct++;
+        }
+    }
+    double accuracy = (double)correct / predictions.size();
+    double calibration_ms = std::chrono::duration<double, std::milli>(calibrated - start).count();
+    double int8_ms = std::chrono::duration<double, std::milli>(end - calibrated).count();
 
-        // calculate loss
-        float loss = sparse_cross_entropy_loss(output_layer.outputs, dataset.test_labels[sample_index]);
-        eval.set_loss(loss, sample_index);
+    std::cout << std::endl
+              << "int8 quantized inference (" << kernels->name << "):" << std::endl
+              << "accuracy: " << accuracy * 100 << "% (fp32 " << fp32_accuracy * 100 << "%, difference "
+              << std::showpos << (accuracy - fp32_accuracy) * 100 << std::noshowpos << " points)" << std::endl
+              << "time: " << int8_ms << " ms, calibration " << calibration_ms << " ms (fp32 " << fp32_ms << " ms)" << std::endl
+              << "samples/s: " << (int)(images.size() / (int8_ms / 1000.0))
+              << " (fp32 " << (int)(images.size() / (fp32_ms / 1000.0)) << ")" << std::endl;
+}
 
-        // display progress (remove for faster training)
-        if (sample_index % 100 == 0)
+/*
+ * scores one evaluation worker's shard, predict(i) leaves the class probabilities of sample i in probabilities
+ */
+template <typename PREDICT>
+static void score_shard(const DATASET_VIEW &shard, const float *probabilities, EVALUATION_COUNTS &counts,
+                        PROGRESS_REPORTER &progress, int worker, int num_classes, PREDICT predict)
+{
+    for (size_t i = 0; i < shard.size(); i++)
+    {
         {
-            progress_bar(sample_index, dataset.test_images.size(), NO_EPOCHS);
+            // the calling thread runs the first worker, only its share is timed
+            TIME_PHASE_IF(worker == 0, PHASE_PREDICT);
+            predict(i);
         }
+        {
+            TIME_PHASE_IF(worker == 0, PHASE_SCORE);
+            int label = shard.label(i);
+            counts.add(max_value_index(probabilities, num_classes), label,
+                       sparse_cross_entropy_loss(probabilities, label));
+        }
+        progress.publish(worker, i + 1, counts.total_loss);
     }
+}
 
-    eval.set_labels(predictions, dataset.test_labels);
+/*
+ * evaluates model by using the validation dataset
+ * the test set is split into one shard per thread of the pool
+ */
+void model_evaluate(const DATASET_VIEW &test, LAYER &layer,
+                    LAYER &output_layer, EVALUATION &eval, int num_neurons, int num_classes, THREAD_POOL &pool)
+{
+    std::cout << "----------------------------------------"
+              << std::endl;
+    std::cout << "Evaluating model on the validation dataset\n";
+    std::cout << "----------------------------------------"
+              << std::endl;
+    std::cout << "Number of samples: " << test.size() << std::endl
+              << std::endl;
+
+    // every worker scores its own shard of the test set with private activations and counts
+    int num_workers = pool.size();
+    std::vector<WORKSPACE> workspaces(num_workers);
+    std::vector<EVALUATION_COUNTS> counts(num_workers);
+    for (int w = 0; w < num_workers; w++)
+    {
+        workspaces[w].initialize_workspace(layer.weights.cols, num_neurons, num_classes);
+        counts[w].initialize_counts(num_classes);
+    }
+
+    eval.initialize_loss();
+    PROGRESS_REPORTER progress;
+    progress.start(test.size(), NO_EPOCHS, num_workers);
+    eval.start_timer();
+
+    // the compile-time network scores the samples when the layers have its shape
+    bool specialized = MNIST_NETWORK::matches(layer, output_layer);
+
+    pool.parallel_for(0, num_workers, [&](int first, int last)
+                      {
+        for (int w = first; w < last; w++)
+        {
+            const DATASET_VIEW shard = test.shard(w, num_workers);
+            if (specialized)
+            {
+                MNIST_NETWORK network(layer, output_layer);
+                score_shard(shard, network.probabilities(), counts[w], progress, w, num_classes, [&](size_t i)
+                            { network.predict(shard.input(i)); });
+            }
+            else
+            {
+                score_shard(shard, workspaces[w].output_outputs, counts[w], progress, w, num_classes, [&](size_t i)
+                            { predict_sample(layer, output_layer, shard.input(i), workspaces[w]); });
+            }
+        } });
+
+    // merge in worker order so the totals do not depend on the timing
+    for (int w = 1; w < num_workers; w++)
+    {
+        counts[0].merge(counts[w]);
+    }
+
+    eval.end_timer();
+    progress.stop();
+
+    eval.set_counts(counts[0]);
+    record_evaluation(test.size(), eval.elapsed.count(), eval.average_loss, eval.accuracy());
     eval.print_metrics();
-    eval.display_confusion_matrix(num_classes);
+    eval.display_confusion_matrix();
     eval.display_precision(num_classes);
+
+    evaluate_quantized(test, layer, output_layer, eval.accuracy(), eval.elapsed.count());
 }
\ No newline at end of file
@@ -0,0 +1,151 @@
+#include "../include/perf_counters.hpp"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+const char *counter_names[NUM_COUNTERS] = {"cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses"};
+
+PERF_COUNTERS::PERF_COUNTERS() : leader(-1), num_open(0), was_multiplexed(false)
+{
+    for (int c = 0; c < NUM_COUNTERS; c++)
+    {
+        this->fds[c] = -1;
+        this->order[c] = -1;
+    }
+}
+
+PERF_COUNTERS::~PERF_COUNTERS()
+{
+    this->close();
+}
+
+void PERF_COUNTERS::close()
+{
+    for (int c = 0; c < NUM_COUNTERS; c++)
+    {
+        if (this->fds[c] >= 0)
+        {
+            ::close(this->fds[c]);
+            this->fds[c] = -1;
+        }
+        this->order[c] = -1;
+    }
+    this->leader = -1;
+    this->num_open = 0;
+}
+
+#ifdef __linux__
+
+/*
+ * open one event of the calling thread, user space only, as part of the group of leader (-1 starts a group)
+ */
+static int open_event(uint32_t type, uint64_t config, int leader)
+{
+    struct perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = leader < 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+}
+
+bool PERF_COUNTERS::open()
+{
+    static const uint32_t types[NUM_COUNTERS] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+                                                 PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE};
+    static const uint64_t configs[NUM_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+    this->close();
+
+    // the first event that opens leads the group, the others join it
+    int error = 0;
+    for (int c = 0; c < NUM_COUNTERS; c++)
+    {
+        int fd = open_event(types[c], configs[c], this->leader);
+        if (fd < 0)
+        {
+            error = errno;
+            continue;
+        }
+        if (this->leader < 0)
+        {
+            this->leader = fd;
+        }
+        this->fds[c] = fd;
+        this->order[this->num_open++] = c;
+    }
+
+    if (this->num_open == 0)
+    {
+        std::cout << "Hardware counters unavailable (" << std::strerror(error) << "), reporting phase times only"
+                  << std::endl;
+        return false;
+    }
+    for (int c = 0; c < NUM_COUNTERS; c++)
+    {
+        if (this->fds[c] < 0)
+        {
+            std::cout << "Hardware counter " << counter_names[c] << " unavailable, reported as n/a" << std::endl;
+        }
+    }
+
+    ioctl(this->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(this->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+}
+
+void PERF_COUNTERS::read(uint64_t *values)
+{
+    std::memset(values, 0, NUM_COUNTERS * sizeof(uint64_t));
+    if (this->num_open == 0)
+    {
+        return;
+    }
+
+    // group layout: number of values, time enabled, time running, then the values in opening order
+    uint64_t buffer[3 + NUM_COUNTERS];
+    ssize_t bytes = ::read(this->leader, buffer, sizeof(buffer));
+    if (bytes < (ssize_t)(3 * sizeof(uint64_t)))
+    {
+        return;
+    }
+
+    uint64_t count = buffer[0] < (uint64_t)this->num_open ? buffer[0] : this->num_open;
+    for (uint64_t i = 0; i < count; i++)
+    {
+        values[this->order[i]] = buffer[3 + i];
+    }
+    if (buffer[2] < buffer[1])
+    {
+        this->was_multiplexed = true;
+    }
+}
+
+#else
+
+bool PERF_COUNTERS::open()
+{
+    std::cout << "Hardware counters need Linux perf_event_open, reporting phase times only" << std::endl;
+    return false;
+}
+
+void PERF_COUNTERS::read(uint64_t *values)
+{
+    std::memset(values, 0, NUM_COUNTERS * sizeof(uint64_t));
+}
+
+#endif
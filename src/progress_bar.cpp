@@ -1,8 +1,10 @@
 #include "../include/progress_bar.hpp"
+#include <cstdlib>
 #include <iostream>
+#include <new>
 #include <thread>
 
-void progress_bar(int progress, int total, int epoch)
+void progress_bar(uint64_t progress, uint64_t total, int epoch)
 {
     if (epoch)
     {
@@ -10,11 +12,12 @@ void progress_bar(int progress, int total, int epoch)
     }
 
     // Calculate the percentage of completion
-    float percent = (float)progress / total * 100;
+    double fraction = (double)progress / total;
+    double percent = fraction * 100;
     int bar_width = 40;
 
     std::cout << "[";
-    int pos = bar_width * progress / total;
+    int pos = (int)(bar_width * fraction);
     for (int i = 0; i < bar_width; ++i)
     {
         if (i < pos)
@@ -23,6 +26,133 @@ void progress_bar(int progress, int total, int epoch)
             std::cout << " ";
     }
 
-    std::cout << "] " << int(percent) << " %\r";
+    std::cout << "] " << int(percent) << " %";
+}
+
+PROGRESS_REPORTER::PROGRESS_REPORTER()
+    : slots(nullptr), num_slots(0), total(0), epoch(NO_EPOCHS), active(false), drawn(true), exiting(false)
+{
+    this->reporter = std::thread(&PROGRESS_REPORTER::report_loop, this);
+}
+
+PROGRESS_REPORTER::~PROGRESS_REPORTER()
+{
+    this->stop();
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->exiting = true;
+    }
+    this->condition.notify_all();
+    this->reporter.join();
+    std::free(this->slots);
+}
+
+void PROGRESS_REPORTER::start(size_t total, int epoch, int num_slots)
+{
+    this->stop();
+
+    // the slots are only reallocated when the number of workers changes
+    if (num_slots != this->num_slots)
+    {
+        std::free(this->slots);
+        void *buffer = nullptr;
+        if (posix_memalign(&buffer, PROGRESS_SLOT_ALIGNMENT, num_slots * sizeof(PROGRESS_SLOT)) != 0)
+        {
+            throw std::bad_alloc();
+        }
+        this->slots = static_cast<PROGRESS_SLOT *>(buffer);
+        for (int s = 0; s < num_slots; s++)
+        {
+            new (&this->slots[s]) PROGRESS_SLOT();
+        }
+        this->num_slots = num_slots;
+    }
+    for (int s = 0; s < num_slots; s++)
+    {
+        this->slots[s].samples.store(0, std::memory_order_relaxed);
+        this->slots[s].loss_sum.store(0.0, std::memory_order_relaxed);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->total = total;
+        this->epoch = epoch;
+        this->start_time = std::chrono::steady_clock::now();
+        this->active = true;
+        this->drawn = false;
+    }
+    this->condition.notify_all();
+}
+
+void PROGRESS_REPORTER::stop()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (!this->active)
+    {
+        return;
+    }
+    this->active = false;
+    this->condition.notify_all();
+    this->condition.wait(lock, [&]
+                         { return this->drawn; });
+}
+
+void PROGRESS_REPORTER::report_loop()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    while (true)
+    {
+        // sleep until the next pass starts
+        this->condition.wait(lock, [&]
+                             { return this->active || this->exiting; });
+        if (this->exiting)
+        {
+            return;
+        }
+
+        while (!this->condition.wait_for(lock, std::chrono::milliseconds(PROGRESS_REFRESH_MS), [&]
+                                         { return !this->active; }))
+        {
+            this->draw();
+        }
+
+        // the pass is over, the last draw shows its final counts
+        this->draw();
+        this->drawn = true;
+        this->condition.notify_all();
+    }
+}
+
+void PROGRESS_REPORTER::draw()
+{
+    uint64_t samples = 0;
+    double loss_sum = 0.0;
+    for (int s = 0; s < this->num_slots; s++)
+    {
+        samples += this->slots[s].samples.load(std::memory_order_relaxed);
+        loss_sum += this->slots[s].loss_sum.load(std::memory_order_relaxed);
+    }
+    if (this->total == 0)
+    {
+        return;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - this->start_time).count();
+    double rate = seconds > 0.0 ? samples / seconds : 0.0;
+
+    progress_bar(std::min(samples, (uint64_t)this->total), this->total, this->epoch);
+    std::cout << " " << samples << "/" << this->total << " samples/s: " << (uint64_t)rate;
+    if (rate > 0.0 && samples < this->total)
+    {
+        std::cout << " ETA: " << (uint64_t)((this->total - samples) / rate) << " s";
+    }
+    if (samples > 0)
+    {
+        std::cout << " loss: " << loss_sum / samples;
+    }
+
+    // clear what is left of a longer previous line
+    std::cout << "        \r";
     std::cout.flush();
-}
\ No newline at end of file
+}
@@ -0,0 +1,130 @@
+#include "../include/quantized_engine.hpp"
+#include "../include/activation.hpp"
+#include "../include/kernels.hpp"
+#include <algorithm>
+#include <cmath>
+
+/*
+ * quantize count weights with the given scale, rounding to the nearest int8 in [-127, 127]
+ */
+static void quantize_row(const float *weights, size_t count, float scale, int8_t *quantized)
+{
+    float inverse = scale > 0.0f ? 1.0f / scale : 0.0f;
+    for (size_t j = 0; j < count; j++)
+    {
+        float value = std::nearbyint(weights[j] * inverse);
+        quantized[j] = (int8_t)std::max(-127.0f, std::min(127.0f, value));
+    }
+}
+
+QuantizedInferenceEngine::QuantizedInferenceEngine(const LAYER &hidden_layer, const LAYER &output_layer,
+                                                   const IMAGE_TENSOR &calibration)
+    : inputs(hidden_layer.weights.cols),
+      neurons(hidden_layer.weights.rows),
+      stride((hidden_layer.weights.cols + MATRIX_ALIGNMENT - 1) / MATRIX_ALIGNMENT * MATRIX_ALIGNMENT),
+      hidden_weights(hidden_layer.weights.rows * stride, 0),
+      row_scales(hidden_layer.weights.rows),
+      hidden_biases(hidden_layer.biases),
+      output_weights(output_layer.weights),
+      output_biases(output_layer.biases),
+      hidden(hidden_layer.weights.rows),
+      logits(output_layer.weights.rows)
+{
+    size_t samples = std::min(calibration.size(), (size_t)CALIBRATION_SAMPLES);
+
+    for (size_t i = 0; i < this->neurons; i++)
+    {
+        this->calibrate_row(i, hidden_layer.weights.row(i), calibration, samples);
+    }
+}
+
+void QuantizedInferenceEngine::calibrate_row(size_t row, const float *weights, const IMAGE_TENSOR &calibration,
+                                             size_t samples)
+{
+    int8_t *quantized = this->hidden_weights.data() + row * this->stride;
+
+    float max_weight = 0.0f;
+    for (size_t j = 0; j < this->inputs; j++)
+    {
+        max_weight = std::max(max_weight, std::fabs(weights[j]));
+    }
+
+    // without calibration images (or weights) the full range is used
+    float best_scale = max_weight / 127.0f;
+    if (samples > 0 && max_weight > 0.0f)
+    {
+        // fp32 weighted sums of the calibration images, in raw pixel units
+        std::vector<float> reference(samples);
+        for (size_t n = 0; n < samples; n++)
+        {
+            reference[n] = dot(weights, calibration.image(n), this->inputs);
+        }
+
+        // keep the clipping range with the smallest squared error
+        const float clips[] = CALIBRATION_CLIPS;
+        double best_error = -1.0;
+        for (size_t c = 0; c < sizeof(clips) / sizeof(clips[0]); c++)
+        {
+            float scale = clips[c] * max_weight / 127.0f;
+            quantize_row(weights, this->inputs, scale, quantized);
+
+            double error = 0.0;
+            for (size_t n = 0; n < samples; n++)
+            {
+                double difference = reference[n] - scale * dot(calibration.image(n), quantized, this->inputs);
+                error += difference * difference;
+            }
+
+            if (best_error < 0.0 || error < best_error)
+            {
+                best_error = error;
+                best_scale = scale;
+            }
+        }
+    }
+
+    quantize_row(weights, this->inputs, best_scale, quantized);
+    this->row_scales[row] = best_scale * PIXEL_SCALE;
+}
+
+void QuantizedInferenceEngine::predict(const uint8_t *images, size_t n, size_t image_stride, int *labels,
+                                       float *probs)
+{
+    size_t classes = this->num_classes();
+    float *activation = this->hidden.data();
+    float *logit = this->logits.data();
+
+    for (size_t r = 0; r < n; r++)
+    {
+        const uint8_t *image = images + r * image_stride;
+
+        // hidden layer: int32 dot products, dequantized per neuron, bias and ReLU
+        for (size_t i = 0; i < this->neurons; i++)
+        {
+            int32_t sum = dot(image, this->hidden_weights.data() + i * this->stride, this->inputs);
+            activation[i] = relu(sum * this->row_scales[i] + this->hidden_biases[i]);
+        }
+
+        // output layer in fp32
+        int best = 0;
+        for (size_t c = 0; c < classes; c++)
+        {
+            logit[c] = dot(this->output_weights.row(c), activation, this->neurons) + this->output_biases[c];
+            if (logit[c] > logit[best])
+            {
+                best = c;
+            }
+        }
+
+        if (labels)
+        {
+            labels[r] = best;
+        }
+
+        if (probs)
+        {
+            std::copy(logit, logit + classes, probs + r * classes);
+            softmax(probs + r * classes, classes);
+        }
+    }
+}
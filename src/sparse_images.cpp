@@ -0,0 +1,30 @@
+#include "../include/sparse_images.hpp"
+
+bool SPARSE_IMAGES::build(const IMAGE_TENSOR &images)
+{
+    this->offsets.clear();
+    this->indices.clear();
+    this->values.clear();
+    this->pixels = images.pixels();
+    if (this->pixels > SPARSE_MAX_PIXELS)
+    {
+        return false;
+    }
+
+    this->offsets.reserve(images.size() + 1);
+    this->offsets.push_back(0);
+    for (size_t i = 0; i < images.size(); i++)
+    {
+        const uint8_t *image = images.image(i);
+        for (size_t j = 0; j < this->pixels; j++)
+        {
+            if (image[j])
+            {
+                this->indices.push_back((uint16_t)j);
+                this->values.push_back(image[j]);
+            }
+        }
+        this->offsets.push_back((uint32_t)this->indices.size());
+    }
+    return true;
+}
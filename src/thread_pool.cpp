@@ -0,0 +1,128 @@
+#include "../include/thread_pool.hpp"
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CPU_RELAX() _mm_pause()
+#else
+#define CPU_RELAX() std::this_thread::yield()
+#endif
+
+SPIN_BARRIER::SPIN_BARRIER(int count, int spin_limit) : count(count), spin_limit(spin_limit), waiting(0), generation(0)
+{
+}
+
+void SPIN_BARRIER::wait()
+{
+    unsigned int current = this->generation.load(std::memory_order_acquire);
+
+    // the last thread to arrive releases the others
+    if (this->waiting.fetch_add(1, std::memory_order_acq_rel) + 1 == this->count)
+    {
+        this->waiting.store(0, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->generation.fetch_add(1, std::memory_order_release);
+        }
+        this->condition.notify_all();
+        return;
+    }
+
+    // spin first, the other threads are usually only a few microseconds behind
+    for (int i = 0; i < this->spin_limit; i++)
+    {
+        if (this->generation.load(std::memory_order_acquire) != current)
+        {
+            return;
+        }
+        CPU_RELAX();
+    }
+
+    // park until the generation changes
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->condition.wait(lock, [&]
+                         { return this->generation.load(std::memory_order_acquire) != current; });
+}
+
+/*
+ * spinning only pays off when every thread has a core of its own
+ */
+static int spin_limit_for(int num_threads)
+{
+    unsigned int cores = std::thread::hardware_concurrency();
+    return (cores == 0 || num_threads <= (int)cores) ? SPIN_LIMIT : 0;
+}
+
+THREAD_POOL::THREAD_POOL(int num_threads)
+    : num_threads(std::max(1, num_threads)),
+      start_barrier(std::max(1, num_threads), spin_limit_for(num_threads)),
+      end_barrier(std::max(1, num_threads), spin_limit_for(num_threads)),
+      stopping(false),
+      job_context(nullptr),
+      job_invoke(nullptr),
+      job_begin(0),
+      job_end(0)
+{
+    // thread 0 is the caller, spawn the rest once
+    for (int i = 1; i < this->num_threads; i++)
+    {
+        this->workers.emplace_back(&THREAD_POOL::worker_loop, this, i);
+    }
+}
+
+THREAD_POOL::~THREAD_POOL()
+{
+    if (this->workers.empty())
+    {
+        return;
+    }
+
+    // wake the workers with the stop flag set
+    this->stopping = true;
+    this->start_barrier.wait();
+
+    for (size_t i = 0; i < this->workers.size(); i++)
+    {
+        this->workers[i].join();
+    }
+}
+
+void THREAD_POOL::run_job()
+{
+    // the start barrier publishes the job, the end barrier waits for all chunks
+    this->start_barrier.wait();
+    this->run_chunk(0);
+    this->end_barrier.wait();
+}
+
+void THREAD_POOL::run_chunk(int thread_index)
+{
+    // calculate the chunk size for each thread
+    // adding num_threads - 1 to round up
+    int total = this->job_end - this->job_begin;
+    int chunk_size = (total + this->num_threads - 1) / this->num_threads;
+
+    int start = this->job_begin + thread_index * chunk_size;
+    int end = std::min(start + chunk_size, this->job_end);
+
+    if (start < end)
+    {
+        this->job_invoke(this->job_context, start, end);
+    }
+}
+
+void THREAD_POOL::worker_loop(int thread_index)
+{
+    while (true)
+    {
+        this->start_barrier.wait();
+
+        if (this->stopping)
+        {
+            return;
+        }
+
+        this->run_chunk(thread_index);
+        this->end_barrier.wait();
+    }
+}
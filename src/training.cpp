@@ -1,28 +1,66 @@
 #include "../include/training.hpp"
-#include <thread>
-#include <functional> // for std::ref
+#include "../include/gemm.hpp"
+#include "../include/kernels.hpp"
+#include "../include/evaluation.hpp"
+#include <atomic>
 
 /*
- * computes the weighted sums for the neurons in the layer
+ * the pixels of one sample in the working precision
+ * fp32 builds read the raw pixels in place, bf16 builds round them into buffer
  */
-void forward_feed(LAYER *layer,
-                  const std::vector<std::vector<float>> &images,
-                  int sample_index, int neurons)
+static inline const working_input_t *working_input(const uint8_t *pixels, working_input_t *buffer, size_t count)
 {
-    // reset weighted sums for this forward pass
-    std::fill(layer->weighted_sums.begin(), layer->weighted_sums.end(), 0.0f);
+#ifdef PRECISION_BF16
+    for (size_t j = 0; j < count; j++)
+    {
+        buffer[j] = float_to_bf16(pixels[j]);
+    }
+    return buffer;
+#else
+    (void)buffer;
+    (void)count;
+    return pixels;
+#endif
+}
 
-    for (int i = 0; i < neurons; i++)
+/*
+ * weighted sums and ReLU activations of hidden neurons [start, end)
+ * the neurons left active are listed in active[start, ...), ended by -1 when fewer than the range
+ * the backward pass walks the list of the same range, returns the length of the list
+ */
+static int forward_feed_range(const LAYER &layer, const working_input_t *input, float *weighted_sums, float *outputs,
+                               int *active, int start, int end)
+{
+    const working_t *weights = layer.working_row(0);
+    size_t inputs = layer.weights.cols;
+    size_t stride = layer.weights.stride;
+    int num_active = start;
+
+    for (int i = start; i < end; i++)
     {
-        // calculate weighted sum
-        for (size_t j = 0; j < layer->weights[i].size(); j++)
-        {
-            layer->weighted_sums[i] += (layer->weights[i][j] * images[sample_index][j]);
-        }
+        // calculate weighted sum, normalizing the pixels from 0-255 to 0-1
+        weighted_sums[i] = dot(weights + i * stride, input, inputs) * PIXEL_SCALE;
 
-        // add bias and apply activation function (ReLU)
-        layer->outputs[i] = relu(layer->weighted_sums[i] + layer->biases[i]);
+        // add bias and apply activation function (ReLU), an active neuron is appended without a branch
+        outputs[i] = relu(weighted_sums[i] + layer.biases[i]);
+        active[num_active] = i;
+        num_active += outputs[i] > 0;
     }
+    if (num_active < end)
+    {
+        active[num_active] = -1;
+    }
+    return num_active - start;
+}
+
+/*
+ * computes the weighted sums for the neurons in the layer
+ */
+void forward_feed(LAYER *layer, const uint8_t *pixels, int neurons)
+{
+    const working_input_t *input = working_input(pixels, layer->working_inputs.data(), layer->weights.cols);
+    layer->num_active = forward_feed_range(*layer, input, layer->weighted_sums.data(), layer->outputs.data(),
+                                           layer->active.data(), 0, neurons);
 }
 
 /*
@@ -30,16 +68,13 @@ void forward_feed(LAYER *layer,
  */
 void feed_output(LAYER *layer, LAYER *input_layer, int neurons)
 {
-    // initialize weighted sums vector
-    std::fill(layer->weighted_sums.begin(), layer->weighted_sums.end(), 0.0f);
+    const MATRIX_VIEW weights = layer->weights.view();
+    const float *input = input_layer->outputs.data();
 
     for (int i = 0; i < neurons; i++)
     {
         // calculate weighted sum
-        for (size_t j = 0; j < layer->weights[i].size(); j++)
-        {
-            layer->weighted_sums[i] += layer->weights[i][j] * input_layer->outputs[j];
-        }
+        layer->weighted_sums[i] = dot(weights.row(i), input, weights.cols);
 
         // add bias
         // no activation function needed here for output layer, softmax will be applied outside
@@ -49,52 +84,48 @@ void feed_output(LAYER *layer, LAYER *input_layer, int neurons)
 
 /*
  * parallel version of forward_feed
+ * the neurons are split across the threads of the pool
  */
-void forward_feed_parallel(LAYER *layer,
-                           const std::vector<std::vector<float>> &images,
-                           int sample_index, int neurons)
+void forward_feed_parallel(LAYER *layer, const uint8_t *pixels, int neurons, THREAD_POOL &pool)
 {
-    // reset weighted sums for this forward pass
-    std::fill(layer->weighted_sums.begin(), layer->weighted_sums.end(), 0.0f);
+    const working_input_t *input = working_input(pixels, layer->working_inputs.data(), layer->weights.cols);
 
-    // define a lambda function to process a range of neurons
-    auto process_neurons = [&](int start, int end)
-    {
-        for (int i = start; i < end; i++)
-        {
-            // calculate weighted sum
-            for (size_t j = 0; j < layer->weights[i].size(); j++)
-            {
-                layer->weighted_sums[i] += (layer->weights[i][j] * images[sample_index][j]);
-            }
-
-            // add bias and apply activation function (ReLU)
-            layer->outputs[i] = relu(layer->weighted_sums[i] + layer->biases[i]);
-        }
-    };
+    // process a range of neurons, the list lengths of the ranges are added up
+    std::atomic<int> num_active(0);
+    pool.parallel_for(0, neurons, [&](int start, int end)
+                      {
+        int count = forward_feed_range(*layer, input, layer->weighted_sums.data(), layer->outputs.data(),
+                                       layer->active.data(), start, end);
+        num_active.fetch_add(count, std::memory_order_relaxed); });
+    layer->num_active = num_active.load(std::memory_order_relaxed);
+}
 
-    // determine the number of threads to use
-    const int num_threads = std::thread::hardware_concurrency();
-    // calculate the chunk size for each thread
-    // adding num_threads - 1 to round up
-    const int chunk_size = (neurons + num_threads - 1) / num_threads;
+/*
+ * update the weights and biases of output neurons [start, end)
+ */
+static void update_output_range(LAYER &layer, const float *input, const float *deltas, float learning_rate,
+                                int start, int end)
+{
+    const MATRIX_VIEW weights = layer.weights.view();
 
-    // create and launch threads
-    std::vector<std::thread> threads;
-    for (int i = 0; i < num_threads; i++)
+    for (int i = start; i < end; i++)
     {
-        int start = i * chunk_size;
-        int end = std::min(start + chunk_size, neurons);
-        if (start < neurons)
-        {
-            threads.emplace_back(process_neurons, start, end);
-        }
+        // update the weights based on gradient descent
+        axpy(-learning_rate * deltas[i], input, weights.row(i), weights.cols);
+
+        // update the bias for the output neuron
+        layer.biases[i] -= learning_rate * deltas[i];
     }
+}
 
-    // join threads
-    for (size_t i = 0; i < threads.size(); i++)
+/*
+ * calculate the output deltas (the gradient propagated back)
+ */
+static void output_deltas(const float *outputs, float *deltas, int classes, int expected_class)
+{
+    for (int i = 0; i < classes; i++)
     {
-        threads[i].join();
+        deltas[i] = outputs[i] - (i == expected_class ? 1.0f : 0.0f);
     }
 }
 
@@ -104,26 +135,78 @@ void forward_feed_parallel(LAYER *layer,
  */
 void backpropagate_output(LAYER &layer, LAYER &input_layer, int expected_class, float learning_rate)
 {
-    std::vector<float> output_deltas(layer.outputs.size());
+    int classes = layer.outputs.size();
+    output_deltas(layer.outputs.data(), layer.deltas.data(), classes, expected_class);
+    update_output_range(layer, input_layer.outputs.data(), layer.deltas.data(), learning_rate, 0, classes);
+}
+
+/*
+ * parallel version of backpropagate_output
+ * the output neurons are split across the threads of the pool
+ */
+void backpropagate_output_parallel(LAYER &layer, LAYER &input_layer, int expected_class, float learning_rate,
+                                   THREAD_POOL &pool)
+{
+    int classes = layer.outputs.size();
+    output_deltas(layer.outputs.data(), layer.deltas.data(), classes, expected_class);
+
+    const float *input = input_layer.outputs.data();
+    pool.parallel_for(0, classes, [&](int start, int end)
+                      { update_output_range(layer, input, layer.deltas.data(), learning_rate, start, end); });
+}
+
+/*
+ * weights of neuron i += alpha * input pixels
+ * the bf16 working copy is refreshed in the same pass
+ */
+static inline void update_input_weights(LAYER &layer, size_t i, float alpha, const uint8_t *input)
+{
+#ifdef PRECISION_BF16
+    axpy(alpha, input, layer.weights.row(i), layer.working.data() + i * layer.weights.stride, layer.weights.cols);
+#else
+    axpy(alpha, input, layer.weights.row(i), layer.weights.cols);
+#endif
+}
+
+/*
+ * backpropagate hidden neurons [start, end), the range forward_feed_range listed the active ones of
+ * computes the deltas of the active neurons and updates their weights and biases,
+ * the inactive ones have a zero delta and are skipped entirely
+ * next_deltas are the deltas of the next layer
+ */
+static void backpropagate_hidden_range(LAYER &layer, const LAYER &next_layer, const int *active,
+                                       const float *next_deltas, const uint8_t *input, float learning_rate,
+                                       float *layer_deltas, int start, int end)
+{
+    const MATRIX_VIEW next_weights = next_layer.weights.view();
 
-    // calculate deltas (the gradient propagated back)
-    for (size_t i = 0; i < layer.outputs.size(); i++)
+    // find the end of the list and initialize the deltas of the listed neurons to 0
+    int last = start;
+    for (; last < end && active[last] >= 0; last++)
     {
-        output_deltas[i] = layer.outputs[i] - (i == (size_t)expected_class ? 1.0f : 0.0f);
+        layer_deltas[active[last]] = 0.0f;
     }
 
-    // update weights and biases for the output layer
-    for (size_t i = 0; i < layer.outputs.size(); i++)
+    // sum the errors weighted by the next layer's weights, the ReLU derivative is 1
+    // walking the rows of the next layer keeps the reads contiguous, only the listed neurons are read
+    for (size_t j = 0; j < next_weights.rows; j++)
     {
-        for (size_t j = 0; j < input_layer.outputs.size(); j++)
+        const float *row = next_weights.row(j);
+        for (int k = start; k < last; k++)
         {
-            // update the weight based on gradient descent
-            layer.weights[i][j] -= learning_rate * output_deltas[i] * input_layer.outputs[j];
+            layer_deltas[active[k]] += next_deltas[j] * row[active[k]];
         }
+    }
 
-        // update the bias for the output neuron
-        layer.biases[i] -= learning_rate * output_deltas[i];
-        layer.deltas[i] = output_deltas[i];
+    for (int k = start; k < last; k++)
+    {
+        int i = active[k];
+
+        // update the weights based on gradient descent, the pixel scale is folded into the step
+        update_input_weights(layer, i, -learning_rate * layer_deltas[i] * PIXEL_SCALE, input);
+
+        // update biases (one bias per neuron in the hidden layer)
+        layer.biases[i] -= learning_rate * layer_deltas[i];
     }
 }
 
@@ -131,38 +214,321 @@ void backpropagate_output(LAYER &layer, LAYER &input_layer, int expected_class,
  * backpropagate the hidden layer
  * update the weights and biases based on the error
  */
-void backpropagate_hidden(LAYER &layer, LAYER &next_layer,
-                          const mnist::MNIST_dataset<std::vector, std::vector<float>, int> &dataset, int sample_index, float learning_rate)
+void backpropagate_hidden(LAYER &layer, LAYER &next_layer, const uint8_t *input, float learning_rate,
+                          WORKSPACE &workspace)
+{
+    backpropagate_hidden_range(layer, next_layer, layer.active.data(), next_layer.deltas.data(),
+                               input, learning_rate, workspace.hidden_deltas, 0, layer.outputs.size());
+}
+
+/*
+ * parallel version of backpropagate_hidden
+ * every thread computes the errors of its own neurons and updates their weights
+ */
+void backpropagate_hidden_parallel(LAYER &layer, LAYER &next_layer, const uint8_t *input,
+                                   float learning_rate, WORKSPACE &workspace, THREAD_POOL &pool)
+{
+    pool.parallel_for(0, layer.outputs.size(), [&](int start, int end)
+                      { backpropagate_hidden_range(layer, next_layer, layer.active.data(), next_layer.deltas.data(),
+                                                   input, learning_rate, workspace.hidden_deltas, start, end); });
+}
+
+/*
+ * forward pass with the activations kept in the workspace
+ */
+void predict_sample(const LAYER &layer, const LAYER &output_layer, const uint8_t *input, WORKSPACE &workspace)
+{
+    const MATRIX_VIEW output_weights = output_layer.weights.view();
+    int neurons = layer.weights.rows;
+    int classes = output_weights.rows;
+
+    // hidden layer, the weighted sums are not needed afterwards so they share the output buffer
+    const working_input_t *working = working_input(input, workspace.working_inputs, layer.weights.cols);
+    workspace.num_active = forward_feed_range(layer, working, workspace.hidden_outputs, workspace.hidden_outputs,
+                                              workspace.active_neurons, 0, neurons);
+
+    // output layer logits and probabilities
+    for (int i = 0; i < classes; i++)
+    {
+        workspace.output_outputs[i] = dot(output_weights.row(i), workspace.hidden_outputs, output_weights.cols) +
+                                      output_layer.biases[i];
+    }
+    softmax(workspace.output_outputs, classes);
+}
+
+/*
+ * one forward and backward pass with the activations kept in the workspace
+ */
+float train_sample(LAYER &layer, LAYER &output_layer, const uint8_t *input,
+                   int expected_class, float learning_rate, WORKSPACE &workspace)
 {
-    std::vector<float> layer_errors(layer.outputs.size());
-    std::vector<float> layer_deltas(layer.outputs.size());
+    int neurons = layer.weights.rows;
+    int classes = output_layer.weights.rows;
+
+    predict_sample(layer, output_layer, input, workspace);
+    float loss = sparse_cross_entropy_loss(workspace.output_outputs, expected_class);
+
+    // backpropagate the output layer, then the hidden layer
+    output_deltas(workspace.output_outputs, workspace.output_deltas, classes, expected_class);
+    update_output_range(output_layer, workspace.hidden_outputs, workspace.output_deltas, learning_rate, 0, classes);
+    backpropagate_hidden_range(layer, output_layer, workspace.active_neurons, workspace.output_deltas, input,
+                               learning_rate, workspace.hidden_deltas, 0, neurons);
 
-    // initialize errors vector to 0
-    std::fill(layer_errors.begin(), layer_errors.end(), 0.0f);
+    return loss;
+}
+
+/*
+ * copies count samples starting at start into the batch
+ */
+void load_batch(BATCH &batch, const DATASET_VIEW &samples, size_t start, size_t count)
+{
+    batch.size = count;
 
-    // compute error for the hidden layer neurons
-    for (size_t i = 0; i < layer.outputs.size(); i++)
+    for (size_t r = 0; r < count; r++)
     {
-        // sum the errors weighted by the next layer's weights
-        for (size_t j = 0; j < next_layer.deltas.size(); j++)
+        // shuffled rows are scattered, fetch the next ones while this one is packed
+        if (samples.order && r + PREFETCH_SAMPLES < count)
         {
-            layer_errors[i] += next_layer.deltas[j] * next_layer.weights[j][i];
+            samples.prefetch(start + r + PREFETCH_SAMPLES);
         }
 
-        // calculate the delta for the layer
-        layer_deltas[i] = layer_errors[i] * (layer.outputs[i] > 0 ? 1.0f : 0.0f);
+        // normalize the pixel values from 0-255 to 0-1 while packing
+        const uint8_t *image = samples.input(start + r);
+        float *row = batch.inputs.row(r);
+        for (size_t j = 0; j < batch.inputs.cols; j++)
+        {
+            row[j] = image[j] * PIXEL_SCALE;
+        }
+        batch.labels[r] = samples.label(start + r);
     }
+}
 
-    // update weights and biases for the layer
-    for (size_t i = 0; i < layer.weights.size(); i++)
+/*
+ * add the biases to every row and optionally apply ReLU
+ */
+static void add_biases(const MATRIX_VIEW &outputs, const std::vector<float> &biases, bool apply_relu)
+{
+    for (size_t r = 0; r < outputs.rows; r++)
     {
-        for (size_t j = 0; j < layer.weights[i].size(); j++)
+        float *row = outputs.row(r);
+        for (size_t i = 0; i < outputs.cols; i++)
         {
-            // update weight based on gradient descent
-            layer.weights[i][j] -= learning_rate * layer_deltas[i] * dataset.training_images[sample_index][j];
+            row[i] = apply_relu ? relu(row[i] + biases[i]) : row[i] + biases[i];
         }
+    }
+}
 
-        // update biases (one bias per neuron in the hidden layer)
-        layer.biases[i] -= learning_rate * layer_deltas[i];
+/*
+ * deltas of the output rows (softmax probabilities minus the one-hot label)
+ */
+static void output_deltas_batch(const MATRIX_VIEW &outputs, const MATRIX_VIEW &deltas, const int *labels)
+{
+    for (size_t r = 0; r < deltas.rows; r++)
+    {
+        for (size_t i = 0; i < deltas.cols; i++)
+        {
+            deltas(r, i) = outputs(r, i) - (i == (size_t)labels[r] ? 1.0f : 0.0f);
+        }
+    }
+}
+
+/*
+ * multiply the error rows by the ReLU derivative of the activations
+ */
+static void relu_derivative(const MATRIX_VIEW &outputs, const MATRIX_VIEW &deltas)
+{
+    for (size_t r = 0; r < deltas.rows; r++)
+    {
+        for (size_t i = 0; i < deltas.cols; i++)
+        {
+            deltas(r, i) *= (outputs(r, i) > 0 ? 1.0f : 0.0f);
+        }
+    }
+}
+
+/*
+ * biases = scale * biases + alpha * deltas summed over the rows
+ */
+static void accumulate_bias(float alpha, const MATRIX_VIEW &deltas, float scale, std::vector<float> &biases)
+{
+    for (size_t i = 0; i < deltas.cols; i++)
+    {
+        biases[i] *= scale;
+    }
+    for (size_t r = 0; r < deltas.rows; r++)
+    {
+        for (size_t i = 0; i < deltas.cols; i++)
+        {
+            biases[i] += alpha * deltas(r, i);
+        }
     }
-}
\ No newline at end of file
+}
+
+/*
+ * view of rows [begin, end) of a matrix
+ */
+static MATRIX_VIEW row_range(const MATRIX &matrix, size_t begin, size_t end)
+{
+    MATRIX_VIEW v = matrix.view();
+    v.data = v.row(begin);
+    v.rows = end - begin;
+    return v;
+}
+
+/*
+ * computes the hidden layer activations for every sample in the batch
+ */
+void forward_feed_batch(LAYER *layer, BATCH &batch)
+{
+    const MATRIX_VIEW outputs = batch.rows(batch.hidden_outputs);
+
+    // weighted sums for the whole batch: inputs (batch x inputs) * weights^T
+    gemm_nt(1.0f, batch.rows(batch.inputs), layer->weights.view(), 0.0f, outputs);
+
+    // add bias and apply activation function (ReLU)
+    add_biases(outputs, layer->biases, true);
+}
+
+/*
+ * computes the output layer logits for every sample in the batch
+ */
+void feed_output_batch(LAYER *layer, BATCH &batch)
+{
+    const MATRIX_VIEW outputs = batch.rows(batch.outputs);
+
+    // weighted sums for the whole batch: hidden outputs (batch x neurons) * weights^T
+    gemm_nt(1.0f, batch.rows(batch.hidden_outputs), layer->weights.view(), 0.0f, outputs);
+
+    // add bias, softmax is applied outside
+    add_biases(outputs, layer->biases, false);
+}
+
+/*
+ * backpropagate the output layer for a whole batch
+ * the hidden errors are taken through the weights before they are updated
+ */
+void backpropagate_output_batch(LAYER &layer, BATCH &batch, float learning_rate)
+{
+    const MATRIX_VIEW deltas = batch.rows(batch.output_deltas);
+
+    // calculate deltas (softmax probabilities minus the one-hot label)
+    output_deltas_batch(batch.rows(batch.outputs), deltas, batch.labels.data());
+
+    // errors of the hidden layer for the whole batch: deltas (batch x classes) * weights
+    gemm_nn(1.0f, deltas, layer.weights.view(), 0.0f, batch.rows(batch.hidden_deltas));
+
+    // weights -= learning_rate * deltas^T * hidden outputs
+    gemm_tn(-learning_rate, deltas, batch.rows(batch.hidden_outputs), 1.0f, layer.weights.view());
+
+    // update the biases with the deltas summed over the batch
+    accumulate_bias(-learning_rate, deltas, 1.0f, layer.biases);
+}
+
+/*
+ * backpropagate the hidden layer for a whole batch
+ * starts from the errors left in the batch by backpropagate_output_batch
+ */
+void backpropagate_hidden_batch(LAYER &layer, BATCH &batch, float learning_rate)
+{
+    const MATRIX_VIEW deltas = batch.rows(batch.hidden_deltas);
+
+    // calculate the deltas with the ReLU derivative
+    relu_derivative(batch.rows(batch.hidden_outputs), deltas);
+
+    // weights -= learning_rate * deltas^T * inputs
+    gemm_tn(-learning_rate, deltas, batch.rows(batch.inputs), 1.0f, layer.weights.view());
+
+    // update the biases with the deltas summed over the batch
+    accumulate_bias(-learning_rate, deltas, 1.0f, layer.biases);
+}
+
+/*
+ * forward and backward pass for rows [begin, end) of the batch
+ */
+void compute_gradients_batch(LAYER &layer, LAYER &output_layer, BATCH &batch,
+                             size_t begin, size_t end, GRADIENTS &gradients)
+{
+    const MATRIX_VIEW inputs = row_range(batch.inputs, begin, end);
+    const MATRIX_VIEW hidden_outputs = row_range(batch.hidden_outputs, begin, end);
+    const MATRIX_VIEW hidden_deltas = row_range(batch.hidden_deltas, begin, end);
+    const MATRIX_VIEW outputs = row_range(batch.outputs, begin, end);
+    const MATRIX_VIEW deltas = row_range(batch.output_deltas, begin, end);
+
+    // forward pass, the probabilities are left in batch.outputs for the loss
+    gemm_nt(1.0f, inputs, layer.weights.view(), 0.0f, hidden_outputs);
+    add_biases(hidden_outputs, layer.biases, true);
+    gemm_nt(1.0f, hidden_outputs, output_layer.weights.view(), 0.0f, outputs);
+    add_biases(outputs, output_layer.biases, false);
+    softmax_batch(outputs);
+
+    // output layer gradients: deltas^T * hidden outputs
+    output_deltas_batch(outputs, deltas, batch.labels.data() + begin);
+    gemm_tn(1.0f, deltas, hidden_outputs, 0.0f, gradients.output_weights.view());
+    accumulate_bias(1.0f, deltas, 0.0f, gradients.output_biases);
+
+    // hidden layer gradients, the errors use the weights from before this batch's update
+    gemm_nn(1.0f, deltas, output_layer.weights.view(), 0.0f, hidden_deltas);
+    relu_derivative(hidden_outputs, hidden_deltas);
+    gemm_tn(1.0f, hidden_deltas, inputs, 0.0f, gradients.hidden_weights.view());
+    accumulate_bias(1.0f, hidden_deltas, 0.0f, gradients.hidden_biases);
+}
+
+/*
+ * sum the gradient rows [start, end) of every thread and apply them to the layer
+ * the sum is built in the first buffer, always in thread order
+ */
+static void reduce_and_update(LAYER &layer, std::vector<GRADIENTS> &gradients,
+                              MATRIX GRADIENTS::*weights_member, std::vector<float> GRADIENTS::*biases_member,
+                              float learning_rate, int start, int end)
+{
+    const MATRIX_VIEW weights = layer.weights.view();
+    MATRIX &sum = gradients[0].*weights_member;
+    std::vector<float> &bias_sum = gradients[0].*biases_member;
+
+    for (int i = start; i < end; i++)
+    {
+        for (size_t t = 1; t < gradients.size(); t++)
+        {
+            axpy(1.0f, (gradients[t].*weights_member).row(i), sum.row(i), weights.cols);
+            bias_sum[i] += (gradients[t].*biases_member)[i];
+        }
+
+        axpy(-learning_rate, sum.row(i), weights.row(i), weights.cols);
+        layer.biases[i] -= learning_rate * bias_sum[i];
+    }
+}
+
+/*
+ * reduce the per-thread gradients and update both layers
+ */
+void apply_gradients(LAYER &layer, LAYER &output_layer, std::vector<GRADIENTS> &gradients, float learning_rate,
+                     THREAD_POOL &pool)
+{
+    pool.parallel_for(0, layer.weights.rows, [&](int start, int end)
+                      { reduce_and_update(layer, gradients, &GRADIENTS::hidden_weights, &GRADIENTS::hidden_biases,
+                                          learning_rate, start, end); });
+    pool.parallel_for(0, output_layer.weights.rows, [&](int start, int end)
+                      { reduce_and_update(output_layer, gradients, &GRADIENTS::output_weights,
+                                          &GRADIENTS::output_biases, learning_rate, start, end); });
+}
+
+/*
+ * data-parallel training step for the loaded batch
+ */
+void train_batch_parallel(LAYER &layer, LAYER &output_layer, BATCH &batch, std::vector<GRADIENTS> &gradients,
+                          float learning_rate, THREAD_POOL &pool)
+{
+    int num_slices = gradients.size();
+
+    // one slice of the batch per gradient buffer, each thread of the pool gets one slice
+    pool.parallel_for(0, num_slices, [&](int first, int last)
+                      {
+        for (int t = first; t < last; t++)
+        {
+            size_t begin = batch.size * t / num_slices;
+            size_t end = batch.size * (t + 1) / num_slices;
+            compute_gradients_batch(layer, output_layer, batch, begin, end, gradients[t]);
+        } });
+
+    apply_gradients(layer, output_layer, gradients, learning_rate, pool);
+}